@@ -0,0 +1,124 @@
+#include "AnalysisModules.h"
+
+// Root headers
+#include "TMath.h"
+#include "TVector2.h"
+
+// c++ headers
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+    TH1D* BookHist1D(TFile* file, std::string name, int nbins, double xlow, double xhigh, std::string xlab)
+    {
+        std::string titles = name+";"+xlab+";Events / bin";
+        TH1D* hist = new TH1D(name.c_str(), titles.c_str(), nbins, xlow, xhigh);
+        hist->Sumw2();
+        hist->SetDirectory(file);
+        return hist;
+    }
+
+    TH1D* BookCutflow(TFile* file, const std::vector<std::string>& cutNames)
+    {
+        TH1D* hist = BookHist1D(file, "cutflow", cutNames.size(), 0., cutNames.size(), "");
+        for (size_t icut=0; icut<cutNames.size(); icut++) hist->GetXaxis()->SetBinLabel(icut+1, cutNames[icut].c_str());
+        return hist;
+    }
+}
+
+// the HistMaker doesn't need a chain, we give it its events batch by batch.
+DiphotonModule::DiphotonModule() : AnalysisModule("diphoton"), histMaker(HistMaker::NoChain())
+{
+}
+
+std::vector<BranchRequest> DiphotonModule::Branches()
+{
+    std::vector<BranchRequest> branches = {{"photon_pt", kFloatVectorBranch}, {"photon_E", kFloatVectorBranch},
+                                           {"photon_eta", kFloatVectorBranch}, {"photon_phi", kFloatVectorBranch}};
+    for (auto branch : WeightBranches()) branches.push_back(branch);
+    return branches;
+}
+
+void DiphotonModule::Book(TFile* outHists)
+{
+    // the weights come from the train, but keep the HistMaker's setting in step with them.
+    histMaker.luminosity_ifb = luminosity_ifb;
+    histMaker.BookHists(outHists);
+}
+
+void DiphotonModule::ProcessBatch(const EventBatch& batch)
+{
+    VectorColumn photon_pt = batch.Vector("photon_pt");
+    VectorColumn photon_E = batch.Vector("photon_E");
+    VectorColumn photon_eta = batch.Vector("photon_eta");
+    VectorColumn photon_phi = batch.Vector("photon_phi");
+    EventWeights(batch, weights);
+
+    for (Long64_t i=0; i<batch.nevents; i++)
+    {
+        VectorView pt = photon_pt[i];
+        histMaker.ProcessEvent(pt.values, photon_E[i].values, photon_eta[i].values, photon_phi[i].values, pt.size(), weights[i]);
+    }
+}
+
+void DiphotonModule::Finish()
+{
+    histMaker.ResetVariableBinStats();
+}
+
+std::vector<BranchRequest> PhotonJetModule::Branches()
+{
+    std::vector<BranchRequest> branches = {{"photon_pt", kFloatVectorBranch}, {"photon_eta", kFloatVectorBranch},
+                                           {"photon_phi", kFloatVectorBranch}, {"jet_pt", kFloatVectorBranch},
+                                           {"jet_eta", kFloatVectorBranch}, {"jet_phi", kFloatVectorBranch}};
+    for (auto branch : WeightBranches()) branches.push_back(branch);
+    return branches;
+}
+
+void PhotonJetModule::Book(TFile* outHists)
+{
+    hist_pTGam = BookHist1D(outHists, "photon_pT", 50, 0., 500., "pT [GeV]");
+    hist_pTJet = BookHist1D(outHists, "jet_pT", 50, 0., 500., "pT [GeV]");
+    hist_balance = BookHist1D(outHists, "pT_balance", 40, 0., 2., "pT^{jet}/pT^{#gamma}");
+    hist_deltaPhi = BookHist1D(outHists, "deltaPhi", 32, 0., TMath::Pi(), "|#Delta#phi(#gamma, jet)|");
+    hist_cutflow = BookCutflow(outHists, cutNames);
+}
+
+void PhotonJetModule::ProcessBatch(const EventBatch& batch)
+{
+    EventWeights(batch, weights);
+    VectorColumn photon_pt = batch.Vector("photon_pt");
+    VectorColumn photon_eta = batch.Vector("photon_eta");
+    VectorColumn photon_phi = batch.Vector("photon_phi");
+    VectorColumn jet_pt = batch.Vector("jet_pt");
+    VectorColumn jet_eta = batch.Vector("jet_eta");
+    VectorColumn jet_phi = batch.Vector("jet_phi");
+
+    for (Long64_t i=0; i<batch.nevents; i++)
+    {
+        float histoweight = weights[i];
+        hist_cutflow->Fill(0., histoweight);
+
+        // leading photon, in the central region (note TTree is in MeV and we want GeV)
+        if (photon_pt[i].size() < 1) continue;
+        float pt_gam = photon_pt[i][0]*0.001;
+        if (!(pt_gam > cut_photon_pt && std::fabs(photon_eta[i][0]) < cut_photon_eta_max)) continue;
+        hist_cutflow->Fill(1., histoweight);
+
+        // leading jet
+        if (jet_pt[i].size() < 1) continue;
+        float pt_jet = jet_pt[i][0]*0.001;
+        if (!(pt_jet > cut_jet_pt && std::fabs(jet_eta[i][0]) < cut_jet_eta_max)) continue;
+        hist_cutflow->Fill(2., histoweight);
+
+        float delta_phi = std::fabs(TVector2::Phi_mpi_pi(photon_phi[i][0] - jet_phi[i][0]));
+        hist_deltaPhi->Fill(delta_phi, histoweight);
+        if (!(delta_phi > cut_delta_phi)) continue;
+        hist_cutflow->Fill(3., histoweight);
+
+        hist_pTGam->Fill(pt_gam, histoweight);
+        hist_pTJet->Fill(pt_jet, histoweight);
+        hist_balance->Fill(pt_jet/pt_gam, histoweight);
+    }
+}
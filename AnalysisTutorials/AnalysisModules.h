@@ -0,0 +1,64 @@
+#ifndef AnalysisModules_h
+#define AnalysisModules_h
+
+#include "AnalysisTrain.h"
+#include "HistMaker.h"
+
+// Root headers
+#include "TH1D.h"
+
+// c++ headers
+#include <string>
+#include <vector>
+
+// The Higgs->GammaGamma selection of the HistMaker as a module of the analysis train. It uses the HistMaker's
+// selection and histograms (change the cuts with histMaker.SetCut, the luminosity is the train's), so its output is
+// the same as part1_process_TTree_root's, which compare_hists_root can check.
+class DiphotonModule : public AnalysisModule
+{
+
+public:
+    DiphotonModule();
+
+    std::vector<BranchRequest> Branches() override;
+    void Book(TFile* outHists) override;
+    void ProcessBatch(const EventBatch& batch) override;
+    void Finish() override;
+
+    HistMaker histMaker;
+
+private:
+    std::vector<float> weights;
+};
+
+// A photon+jet control region: a leading photon and a leading jet back to back in phi, e.g. for checking the
+// photon energy scale against the jet recoil.
+class PhotonJetModule : public AnalysisModule
+{
+
+public:
+    PhotonJetModule() : AnalysisModule("photonjet") {}
+
+    std::vector<BranchRequest> Branches() override;
+    void Book(TFile* outHists) override;
+    void ProcessBatch(const EventBatch& batch) override;
+
+    float cut_photon_pt = 35.; // GeV
+    float cut_photon_eta_max = 2.37;
+    float cut_jet_pt = 30.; // GeV
+    float cut_jet_eta_max = 2.5;
+    float cut_delta_phi = 2.8; // minimum |delta phi| between the photon and the jet
+
+    TH1D *hist_pTGam;
+    TH1D *hist_pTJet;
+    TH1D *hist_balance;
+    TH1D *hist_deltaPhi;
+    TH1D *hist_cutflow;
+
+    std::vector<std::string> cutNames = {"all", "photon", "jet", "back to back"};
+
+private:
+    std::vector<float> weights;
+};
+
+#endif /* AnalysisModules_h */
@@ -0,0 +1,203 @@
+#include "AnalysisTrain.h"
+#include "HistMaker.h"
+
+// Root headers
+#include "TROOT.h"
+
+// c++ headers
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+#include <iostream>
+#include <stdexcept>
+
+const std::vector<double>& EventBatch::Scalar(const std::string& name) const
+{
+    auto column = scalars.find(name);
+    if (column == scalars.end()) throw std::runtime_error("no branch "+name+" in the batch, is it in the module's Branches()?");
+    return column->second;
+}
+
+VectorColumn EventBatch::Vector(const std::string& name) const
+{
+    auto column = vectorValues.find(name);
+    if (column == vectorValues.end()) throw std::runtime_error("no branch "+name+" in the batch, is it in the module's Branches()?");
+    return {&column->second, &vectorOffsets.at(name)};
+}
+
+std::vector<BranchRequest> AnalysisModule::WeightBranches()
+{
+    if (isData) return {};
+    return {{"mcWeight", kFloatBranch}, {"XSection", kFloatBranch}, {"SumWeights", kFloatBranch}, {"scaleFactor_PILEUP", kFloatBranch}};
+}
+
+void AnalysisModule::EventWeights(const EventBatch& batch, std::vector<float>& weights)
+{
+    // the HistMaker's weights, so the histograms come out identical to part1_process_TTree_root's.
+    weights.assign(batch.nevents, 1.0);
+    if (isData) return;
+    const std::vector<double>& mcWeight = batch.Scalar("mcWeight");
+    const std::vector<double>& xsec_ipb = batch.Scalar("XSection");
+    const std::vector<double>& sumWeights = batch.Scalar("SumWeights");
+    const std::vector<double>& pileupSF = batch.Scalar("scaleFactor_PILEUP");
+    for (Long64_t i=0; i<batch.nevents; i++)
+    {
+        weights[i] = HistMaker::EventWeight(mcWeight[i], xsec_ipb[i], sumWeights[i], pileupSF[i], luminosity_ifb);
+    }
+}
+
+void AnalysisTrain::AddModule(AnalysisModule* module)
+{
+    modules.push_back(module);
+    std::cout << "Adding module " << module->name << " to the train" << std::endl;
+}
+
+void AnalysisTrain::SetupBranches(TChain* chain)
+{
+    // the union of the branches all the modules want, each read once however many modules use it.
+    std::map<std::string, BranchKind> wanted;
+    for (auto module : modules)
+    {
+        for (auto request : module->Branches())
+        {
+            if (wanted.count(request.name) && wanted[request.name] != request.kind)
+            {
+                throw std::runtime_error("modules ask for branch "+request.name+" with different types");
+            }
+            wanted[request.name] = request.kind;
+        }
+    }
+
+    // the buffers mustn't move once the chain has their addresses.
+    buffers.clear();
+    buffers.resize(wanted.size());
+    size_t ibuffer = 0;
+    for (auto branch : wanted) buffers[ibuffer++].request = {branch.first, branch.second};
+
+    chain->SetBranchStatus("*", 0);
+    chain->SetCacheSize(cacheSize);
+    for (auto& buffer : buffers)
+    {
+        const char* name = buffer.request.name.c_str();
+        if (!chain->GetBranch(name)) throw std::runtime_error("no branch "+buffer.request.name+" in the input");
+        chain->SetBranchStatus(name, 1);
+        if (buffer.request.kind == kFloatBranch) chain->SetBranchAddress(name, &buffer.floatValue);
+        else if (buffer.request.kind == kIntBranch) chain->SetBranchAddress(name, &buffer.intValue);
+        else if (buffer.request.kind == kUIntBranch) chain->SetBranchAddress(name, &buffer.uintValue);
+        else chain->SetBranchAddress(name, &buffer.vectorValue);
+        chain->AddBranchToCache(name, true);
+    }
+    std::cout << "Reading " << buffers.size() << " branches for " << modules.size() << " modules" << std::endl;
+}
+
+void AnalysisTrain::ReadBatch(TChain* chain, Long64_t first, Long64_t nentries, EventBatch& batch)
+{
+    // read the entries [first, first+batchSize) into batch, reusing its memory from the last time.
+    batch.firstEntry = first;
+    batch.nevents = std::max(Long64_t(0), std::min(batchSize, nentries - first));
+
+    // find each buffer's column once rather than for every entry.
+    std::vector<std::vector<double>*> scalarColumns(buffers.size(), nullptr);
+    std::vector<std::vector<float>*> valueColumns(buffers.size(), nullptr);
+    std::vector<std::vector<Long64_t>*> offsetColumns(buffers.size(), nullptr);
+    for (size_t ibuffer=0; ibuffer<buffers.size(); ibuffer++)
+    {
+        const std::string& name = buffers[ibuffer].request.name;
+        if (buffers[ibuffer].request.kind == kFloatVectorBranch)
+        {
+            valueColumns[ibuffer] = &batch.vectorValues[name];
+            valueColumns[ibuffer]->clear();
+            offsetColumns[ibuffer] = &batch.vectorOffsets[name];
+            offsetColumns[ibuffer]->assign(1, 0);
+        }
+        else
+        {
+            scalarColumns[ibuffer] = &batch.scalars[name];
+            scalarColumns[ibuffer]->clear();
+        }
+    }
+
+    for (Long64_t entry=first; entry<first+batch.nevents; entry++)
+    {
+        chain->GetEntry(entry);
+        for (size_t ibuffer=0; ibuffer<buffers.size(); ibuffer++)
+        {
+            const BranchBuffer& buffer = buffers[ibuffer];
+            switch (buffer.request.kind)
+            {
+                case kFloatBranch: scalarColumns[ibuffer]->push_back(buffer.floatValue); break;
+                case kIntBranch: scalarColumns[ibuffer]->push_back(buffer.intValue); break;
+                case kUIntBranch: scalarColumns[ibuffer]->push_back(buffer.uintValue); break;
+                case kFloatVectorBranch:
+                    valueColumns[ibuffer]->insert(valueColumns[ibuffer]->end(), buffer.vectorValue->begin(), buffer.vectorValue->end());
+                    offsetColumns[ibuffer]->push_back(valueColumns[ibuffer]->size());
+                    break;
+            }
+        }
+    }
+}
+
+void AnalysisTrain::Run(TChain* chain, std::string outputPrefix, bool isData)
+{
+    ///
+    // Read the chain once, in batches, and give each batch to every module. With parallel set the modules each run
+    // on their own thread while the next batch is read; each module still sees the batches one at a time in entry
+    // order, so its output is the same as running it on its own.
+    //
+    auto start = std::chrono::steady_clock::now();
+    if (modules.empty()) throw std::runtime_error("no modules in the analysis train");
+    if (parallel) ROOT::EnableThreadSafety();
+
+    std::vector<TFile*> outFiles;
+    for (auto module : modules)
+    {
+        module->isData = isData;
+        module->luminosity_ifb = luminosity_ifb;
+        std::string outName = outputPrefix + module->name + ".root";
+        TFile* outHists = TFile::Open(outName.c_str(), "RECREATE");
+        if (!outHists || outHists->IsZombie()) throw std::runtime_error("couldn't create "+outName);
+        module->Book(outHists);
+        outFiles.push_back(outHists);
+    }
+
+    SetupBranches(chain);
+    Long64_t nentries = chain->GetEntries();
+    std::cout << "There are " << nentries << " events in the TTree" << std::endl;
+
+    // two batches: the modules work on one while the next is read into the other.
+    EventBatch batches[2];
+    int current = 0;
+    ReadBatch(chain, 0, nentries, batches[current]);
+    while (batches[current].nevents > 0)
+    {
+        const EventBatch& batch = batches[current];
+        std::vector<std::future<void>> running;
+        for (auto module : modules)
+        {
+            if (parallel) running.push_back(std::async(std::launch::async, [module, &batch]() { module->ProcessBatch(batch); }));
+            else module->ProcessBatch(batch);
+        }
+
+        Long64_t next = batch.firstEntry + batch.nevents;
+        ReadBatch(chain, next, nentries, batches[1 - current]);
+        // get() passes on any exception thrown by a module.
+        for (auto& result : running) result.get();
+
+        int pcnt_done = static_cast<int>(std::round(100.*next/nentries));
+        std::cout << "Processed " << next << " events, " << pcnt_done << "% done." << std::endl;
+        current = 1 - current;
+    }
+
+    for (size_t imodule=0; imodule<modules.size(); imodule++)
+    {
+        modules[imodule]->Finish();
+        outFiles[imodule]->Write();
+        outFiles[imodule]->Close();
+        delete outFiles[imodule];
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Ran " << modules.size() << " modules over " << nentries << " events in " << seconds << " s, reading "
+              << TFile::GetFileBytesRead()/1.e6 << " MB from the input." << std::endl;
+}
@@ -0,0 +1,132 @@
+#ifndef AnalysisTrain_h
+#define AnalysisTrain_h
+
+// Root headers
+#include "TChain.h"
+#include "TFile.h"
+
+// c++ headers
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+An analysis "train": several independent analyses (modules) riding on one read of the input.
+Each module says which branches it needs, the AnalysisTrain reads the union of them once, in batches of entries,
+and hands every batch to all the modules - in parallel, while it reads the next batch. So adding another analysis
+costs its own processing time but (almost) no extra I/O.
+
+To add an analysis, derive from AnalysisModule (see AnalysisModules.h for examples) and AddModule it to the train.
+*/
+
+// The types of the branches in the mini trees a module can ask for.
+enum BranchKind { kFloatBranch, kIntBranch, kUIntBranch, kFloatVectorBranch };
+
+struct BranchRequest
+{
+    std::string name;
+    BranchKind kind;
+};
+
+// The values of a vector branch for one event.
+struct VectorView
+{
+    const float* values = nullptr;
+    size_t n = 0;
+
+    size_t size() const { return n; }
+    float operator[](size_t i) const { return values[i]; }
+};
+
+// A vector branch over a batch, flattened: the values of event i are values[offsets[i]] to values[offsets[i+1]].
+struct VectorColumn
+{
+    const std::vector<float>* values = nullptr;
+    const std::vector<Long64_t>* offsets = nullptr;
+
+    VectorView operator[](Long64_t event) const
+    {
+        return {values->data() + (*offsets)[event], size_t((*offsets)[event+1] - (*offsets)[event])};
+    }
+};
+
+// A batch of consecutive entries of the input with the branches the modules asked for, one column per branch.
+// Scalar branches are stored as doubles (exact for the float and int branches), vector branches flattened.
+class EventBatch
+{
+
+public:
+    Long64_t firstEntry = 0;
+    Long64_t nevents = 0;
+
+    // look up a column once per batch, not per event.
+    const std::vector<double>& Scalar(const std::string& name) const;
+    VectorColumn Vector(const std::string& name) const;
+
+    std::map<std::string, std::vector<double>> scalars;
+    std::map<std::string, std::vector<float>> vectorValues;
+    std::map<std::string, std::vector<Long64_t>> vectorOffsets;
+};
+
+// Base class of an analysis in the train. ProcessBatch is called for each batch in entry order, but can run at the
+// same time as the other modules' ProcessBatch, so a module should only touch its own members and histograms.
+class AnalysisModule
+{
+
+public:
+    AnalysisModule(std::string name) : name(name) {}
+    virtual ~AnalysisModule() {}
+
+    // the branches this module reads, asked for after isData is set.
+    virtual std::vector<BranchRequest> Branches() = 0;
+    // book the output histograms, attached to outHists.
+    virtual void Book(TFile* outHists) = 0;
+    virtual void ProcessBatch(const EventBatch& batch) = 0;
+    // anything to do once all the events are processed, before the histograms are written.
+    virtual void Finish() {}
+
+    // the branches needed for the MC event weights (none for data), and the weights themselves, as the HistMaker does them.
+    std::vector<BranchRequest> WeightBranches();
+    void EventWeights(const EventBatch& batch, std::vector<float>& weights);
+
+    std::string name; // also names the output file
+    bool isData = false; // set by the AnalysisTrain
+    float luminosity_ifb = 10.; // set by the AnalysisTrain
+};
+
+class AnalysisTrain
+{
+
+public:
+    // the modules aren't owned by the train.
+    void AddModule(AnalysisModule* module);
+    // read the chain once and run all the modules on it, each writing to <outputPrefix><module name>.root
+    void Run(TChain* chain, std::string outputPrefix, bool isData);
+
+    std::vector<AnalysisModule*> modules;
+    // the luminosity the MC is weighted to, the same for all the modules.
+    float luminosity_ifb = 10.;
+    Long64_t batchSize = 10000;
+    // run the modules on their own threads, while the next batch is read. Off runs them one after another.
+    bool parallel = true;
+    // TTreeCache size in bytes, the wanted branches are read in big blocks.
+    Long64_t cacheSize = 30000000;
+
+private:
+    // where the chain reads each wanted branch into for the current entry.
+    struct BranchBuffer
+    {
+        BranchRequest request;
+        Float_t floatValue = 0.;
+        Int_t intValue = 0;
+        UInt_t uintValue = 0;
+        std::vector<Float_t>* vectorValue = nullptr;
+    };
+
+    void SetupBranches(TChain* chain);
+    void ReadBatch(TChain* chain, Long64_t first, Long64_t nentries, EventBatch& batch);
+
+    std::vector<BranchBuffer> buffers;
+};
+
+#endif /* AnalysisTrain_h */
@@ -0,0 +1,47 @@
+#define BinLookup_cpp
+#include "BinLookup.h"
+
+// c++ headers
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+
+BinLookup::BinLookup(const std::vector<double>& edges) : edges(edges)
+{
+    // strictly increasing, as a zero-width bin would make the grid infinitely fine.
+    if (edges.size() < 2 || std::adjacent_find(edges.begin(), edges.end(), std::greater_equal<double>()) != edges.end())
+    {
+        throw std::runtime_error("bin edges need to be at least 2 strictly increasing values");
+    }
+    nbins = edges.size() - 1;
+    xlow = edges.front();
+    xhigh = edges.back();
+
+    // one grid cell per narrowest bin width, so a cell overlaps at most two bins, within a sensible table size.
+    double minWidth = xhigh - xlow;
+    for (int bin=1; bin<=nbins; bin++) minWidth = std::min(minWidth, edges[bin] - edges[bin-1]);
+    int ncells = std::min(1 << 16, std::max(nbins, static_cast<int>(std::ceil((xhigh - xlow)/minWidth))));
+    cellsPerUnit = ncells/(xhigh - xlow);
+
+    cellBin.resize(ncells);
+    int bin = 1;
+    for (int cell=0; cell<ncells; cell++)
+    {
+        double cellLow = xlow + cell/cellsPerUnit;
+        while (bin < nbins && cellLow >= edges[bin]) bin++;
+        cellBin[cell] = bin;
+    }
+}
+
+int BinLookup::FindBin(double x) const
+{
+    if (x < xlow) return 0;
+    if (!(x < xhigh)) return nbins + 1; // also catches NaN, like ROOT
+    int cell = std::min(static_cast<int>((x - xlow)*cellsPerUnit), static_cast<int>(cellBin.size()) - 1);
+    int bin = cellBin[cell];
+    // correct for the bin edges inside the cell (and rounding at the cell edges)
+    while (bin < nbins && x >= edges[bin]) bin++;
+    while (bin > 1 && x < edges[bin-1]) bin--;
+    return bin;
+}
@@ -0,0 +1,28 @@
+#ifndef BinLookup_h
+#define BinLookup_h
+
+// c++ headers
+#include <vector>
+
+// O(1) bin finding for variable-width bins. The axis range is cut into a fine uniform grid, no finer than the
+// narrowest bin, and for each grid cell we store the bin its lower edge falls in. A lookup is then one multiply,
+// one table read and a correction step of (almost always) zero or one bin, instead of a binary search over the edges.
+// Gives the same bin numbers as TAxis::FindFixBin: 0 for underflow, nbins+1 for overflow.
+class BinLookup
+{
+
+public:
+    BinLookup(const std::vector<double>& edges);
+
+    int FindBin(double x) const;
+
+private:
+    std::vector<double> edges;
+    int nbins;
+    double xlow;
+    double xhigh;
+    double cellsPerUnit;
+    std::vector<int> cellBin; // bin containing the lower edge of each grid cell
+};
+
+#endif /* BinLookup_h */
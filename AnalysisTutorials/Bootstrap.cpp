@@ -0,0 +1,94 @@
+#define Bootstrap_cpp
+#include "Bootstrap.h"
+
+// c++ headers
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    // splitmix64 finaliser: a good 64 bit mix of its input, so hashing (key, replica) gives independent uniform numbers.
+    inline uint64_t mix64(uint64_t x)
+    {
+        x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    // cumulative Poisson(1) probabilities P(k <= j), scaled to 32 bits. A uniform 32 bit number is then Poisson(1)
+    // distributed k = the number of thresholds it is above. Stopping at k=11 misses a probability of ~1e-9.
+    const int kNThresholds = 11;
+    const uint32_t kPoissonThresholds[kNThresholds] = {
+        1580030168u, 3160060337u, 3950075421u, 4213413783u, 4279248373u, 4292415291u,
+        4294609777u, 4294923276u, 4294962463u, 4294966817u, 4294967252u
+    };
+}
+
+BootstrapWeights::BootstrapWeights(int nReplicas, uint64_t seed) : nReplicas(nReplicas), seed(seed)
+{
+    weights.resize(nReplicas);
+}
+
+void BootstrapWeights::Generate(uint32_t run, uint32_t event)
+{
+    uint64_t key = mix64((uint64_t(run) << 32 | event) ^ mix64(seed));
+    // no branches or state between replicas, so the compiler can vectorise this loop.
+    for (int replica=0; replica<nReplicas; replica++)
+    {
+        uint32_t u = mix64(key + uint64_t(replica + 1)*0x9e3779b97f4a7c15ULL) >> 32;
+        int k = 0;
+        for (int j=0; j<kNThresholds; j++) k += (u >= kPoissonThresholds[j]);
+        weights[replica] = k;
+    }
+}
+
+BootstrapHist1D::BootstrapHist1D(TH1D* hist, int nReplicas) : hist(hist), nReplicas(nReplicas)
+{
+    ncells = hist->GetNbinsX() + 2;
+    sumw.resize(ncells*nReplicas, 0.);
+}
+
+void BootstrapHist1D::FillBin(int bin, double w, const double* __restrict__ replicaWeights)
+{
+    double* __restrict__ row = sumw.data() + bin*nReplicas;
+    for (int replica=0; replica<nReplicas; replica++) row[replica] += w*replicaWeights[replica];
+}
+
+TH2D* BootstrapHist1D::MakeHist2D(TFile* file)
+{
+    // the replicas as a TH2D named <hist>_bootstrap, with the original binning on x and one y bin per replica.
+    std::string name = std::string(hist->GetName()) + "_bootstrap";
+    std::string titles = name + ";" + hist->GetXaxis()->GetTitle() + ";replica";
+    const TAxis* xaxis = hist->GetXaxis();
+    TH2D* replicas;
+    if (xaxis->IsVariableBinSize())
+    {
+        replicas = new TH2D(name.c_str(), titles.c_str(), xaxis->GetNbins(), xaxis->GetXbins()->GetArray(), nReplicas, 0., nReplicas);
+    }
+    else
+    {
+        replicas = new TH2D(name.c_str(), titles.c_str(), xaxis->GetNbins(), xaxis->GetXmin(), xaxis->GetXmax(), nReplicas, 0., nReplicas);
+    }
+    replicas->SetDirectory(file);
+    for (int bin=0; bin<ncells; bin++)
+    {
+        for (int replica=0; replica<nReplicas; replica++) replicas->SetBinContent(bin, replica+1, sumw[bin*nReplicas + replica]);
+    }
+    replicas->SetEntries(hist->GetEntries());
+    return replicas;
+}
+
+void BootstrapHist1D::Save(TDirectory* dir)
+{
+    // the replica sums so far, for a checkpoint.
+    dir->WriteObject(&sumw, (std::string(hist->GetName()) + "_bootstrap_sumw").c_str());
+}
+
+void BootstrapHist1D::Load(TDirectory* dir)
+{
+    std::vector<double>* saved = dir->Get<std::vector<double>>((std::string(hist->GetName()) + "_bootstrap_sumw").c_str());
+    if (!saved || saved->size() != sumw.size()) throw std::runtime_error(std::string("checkpoint doesn't match the bootstrap replicas of ") + hist->GetName());
+    sumw = *saved;
+    delete saved;
+}
@@ -0,0 +1,50 @@
+#ifndef Bootstrap_h
+#define Bootstrap_h
+
+// Root headers
+#include "TH1D.h"
+#include "TH2D.h"
+#include "TFile.h"
+
+// c++ headers
+#include <cstdint>
+#include <vector>
+
+// Poisson(1) bootstrap weights for nReplicas replicas of an event, from a counter-based random number generator keyed
+// on (run, event). The same event always gets the same weights, whatever order or thread it's processed in, and
+// without any generator state to carry around.
+class BootstrapWeights
+{
+
+public:
+    BootstrapWeights(int nReplicas, uint64_t seed = 0);
+
+    void Generate(uint32_t run, uint32_t event);
+
+    int nReplicas;
+    uint64_t seed;
+    std::vector<double> weights; // one per replica, 0, 1, 2, ... with Poisson(1) probabilities
+};
+
+// The replicas of one TH1D: the bins laid out as [bin][replica], so one fill is a single contiguous (vectorisable)
+// multiply-add over all replicas.
+class BootstrapHist1D
+{
+
+public:
+    BootstrapHist1D(TH1D* hist, int nReplicas);
+
+    void FillBin(int bin, double w, const double* replicaWeights);
+    TH2D* MakeHist2D(TFile* file);
+    void Save(TDirectory* dir);
+    void Load(TDirectory* dir);
+
+    TH1D* hist;
+
+private:
+    int nReplicas;
+    int ncells; // bins including underflow and overflow
+    std::vector<double> sumw; // [bin*nReplicas + replica]
+};
+
+#endif /* Bootstrap_h */
@@ -11,11 +11,19 @@
 #include "TLorentzVector.h"
 #include "TMath.h"
 #include "Math/Vector4D.h"
+#include "TParameter.h"
 
 // c++ headers
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
 #include <iostream>
+#include <mutex>
 #include <sys/stat.h>
 #include <stdexcept>
+#include <thread>
 
 HistMaker::HistMaker(TTree *tree)
 {
@@ -39,10 +47,22 @@ HistMaker::HistMaker(TTree *tree)
 
 }
 
+HistMaker::HistMaker(NoChain)
+{
+    fChain = nullptr;
+    fCurrent = -1;
+    ownsChainFiles = false;
+}
+
 HistMaker::~HistMaker()
 {
     // Destructor
-    if (!fChain) return;
+    if (ownsHists)
+    {
+        for (auto hist : registeredHists) delete hist;
+        for (auto hist : bootstrapHists) delete hist;
+    }
+    if (!fChain || !ownsChainFiles) return;
     delete fChain->GetCurrentFile();
 }
 
@@ -53,9 +73,9 @@ Long64_t HistMaker::GetNEvents()
     // TODO
     //
     Long64_t nentries = fChain->GetEntries();
-    if (nentries==0){
-        std::cerr << "oh no, the files are empty or read in wrong :( ";
-        return EXIT_FAILURE;
+    if (nentries<=0){
+        // carrying on would read entry 0 of nothing, so stop here.
+        throw std::runtime_error("oh no, the files are empty or read in wrong :(");
     }
     return nentries;
 }
@@ -70,10 +90,69 @@ void HistMaker::SetupHist1D(TH1D*& hist, TFile* file, std::string name, int nbin
     // Make sure it stores sum of weights squared and sets bin errors as sqrt(sum-of-weights), correct for weighted histogram.
     hist->Sumw2();
     hist->SetDirectory(file);
+    // the unique ID is free for us to use, so keep the index of the histogram's filler in it.
+    hist->SetUniqueID(fillers.size());
+    fillers.push_back(HistFiller());
+    registeredHists.push_back(hist);
     std::cout << "Registering histogram... " << name << std::endl;
 
 }
 
+void HistMaker::SetupHist1D(TH1D*& hist, TFile* file, std::string name, std::vector<double> edges, std::string xlab)
+{
+    // same as above but with variable-width bins, given by their edges. Filling uses a lookup table to find the bin.
+    std::string titles = name+";"+xlab+";Events / bin";
+    hist = new TH1D(name.c_str(), titles.c_str(), edges.size()-1, edges.data());
+    hist->Sumw2();
+    hist->SetDirectory(file);
+    hist->SetUniqueID(fillers.size());
+    registeredHists.push_back(hist);
+    // map nodes don't move, so the filler can point at the lookup.
+    HistFiller filler;
+    filler.lookup = &binLookups.emplace(hist, BinLookup(edges)).first->second;
+    fillers.push_back(filler);
+    std::cout << "Registering histogram... " << name << " (variable bins)" << std::endl;
+}
+
+void HistMaker::ResetVariableBinStats()
+{
+    // the variable-bin histograms are filled bin by bin, so work out their mean/rms from the bins at the end.
+    for (auto& lookup : binLookups)
+    {
+        double entries = lookup.first->GetEntries();
+        lookup.first->ResetStats();
+        lookup.first->SetEntries(entries);
+    }
+}
+
+std::map<std::string, float*> HistMaker::CutSettings()
+{
+    // the selection settings by name, as used by SetCut and saved in the cut cache.
+    return {
+        {"photon_eta_max", &cut_photon_eta_max},
+        {"photon_eta_crack_low", &cut_photon_eta_crack_low},
+        {"photon_eta_crack_high", &cut_photon_eta_crack_high},
+        {"photon_1_pt", &cut_photon_1_pt},
+        {"photon_2_pt", &cut_photon_2_pt},
+        {"photon_1_pt_over_m", &cut_photon_1_pt_over_m},
+        {"photon_2_pt_over_m", &cut_photon_2_pt_over_m},
+        {"luminosity_ifb", &luminosity_ifb}
+    };
+}
+
+bool HistMaker::SetCut(std::string name, float value)
+{
+    // change one of the selection settings by name, returns false if there is no cut with that name.
+    std::map<std::string, float*> cuts = CutSettings();
+    if (cuts.find(name) == cuts.end())
+    {
+        std::cerr << "no cut called " << name << std::endl;
+        return false;
+    }
+    *cuts[name] = value;
+    return true;
+}
+
 
 void HistMaker::Init(TTree *tree)
 {
@@ -105,6 +184,15 @@ void HistMaker::Init(TTree *tree)
     fChain->SetBranchAddress("SumWeights", &sumWeights);//, &b_sumWeights);
     fChain->SetBranchStatus("scaleFactor_PILEUP", 1);
     fChain->SetBranchAddress("scaleFactor_PILEUP", &pileupSF);//, &b_pileupSF);
+
+    // the bootstrap weights are keyed on the run and event numbers, only read them if we need them.
+    if (nBootstrap > 0)
+    {
+        fChain->SetBranchStatus("runNumber", 1);
+        fChain->SetBranchAddress("runNumber", &runNumber);
+        fChain->SetBranchStatus("eventNumber", 1);
+        fChain->SetBranchAddress("eventNumber", &eventNumber);
+    }
     
     // TODO include the scaleFactor_PHOTON in the event weight
     
@@ -112,14 +200,14 @@ void HistMaker::Init(TTree *tree)
 
 }
 
-void HistMaker::EventLooper(TChain* chain, TFile *outHists, bool isData)
+void HistMaker::BookHists(TFile* outHists)
 {
-    ///
-    // TODO
-    //
-
-    SetupHist1D(hist_pTGam_1, outHists, "photon_pT_1", 100, 0., 500., "pT [GeV]");
-    SetupHist1D(hist_pTGam_2, outHists, "photon_pT_2", 100, 0., 500., "pT [GeV]");
+    // book all the output histograms, attached to outHists (or kept in memory if it's null).
+    registeredHists.clear();
+    binLookups.clear();
+    fillers.clear();
+    SetupHist1D(hist_pTGam_1, outHists, "photon_pT_1", photonPtEdges, "pT [GeV]");
+    SetupHist1D(hist_pTGam_2, outHists, "photon_pT_2", photonPtEdges, "pT [GeV]");
     SetupHist1D(hist_EGam_1, outHists, "photon_E_1", 100, 0., 500., "E [GeV]");
     SetupHist1D(hist_EGam_2, outHists, "photon_E_2", 100, 0., 500., "E [GeV]");
     SetupHist1D(hist_etaGam_1, outHists, "photon_eta_1", 10, -2.5, 2.5, "#eta");
@@ -128,15 +216,319 @@ void HistMaker::EventLooper(TChain* chain, TFile *outHists, bool isData)
     SetupHist1D(hist_phiGam_2, outHists, "photon_phi_2", 10, -4., 4., "#phi");
     SetupHist1D(hist_mGamGam, outHists, "diphoton_mass", 100, 0., 1000., "m#gamma#gamma [GeV]");
 
+    // the cutflow has one bin per selection stage, filled with the event weights of the events passing it.
+    SetupHist1D(hist_cutflow, outHists, "cutflow", cutNames.size(), 0., cutNames.size(), "");
+    for (size_t icut=0; icut<cutNames.size(); icut++) hist_cutflow->GetXaxis()->SetBinLabel(icut+1, cutNames[icut].c_str());
+
+    // without an output file the histograms just live in memory, e.g. when called from python.
+    ownsHists = (outHists == nullptr);
+}
+
+bool HistMaker::PassFiducial(float eta_1, float eta_2)
+{
+    return (std::fabs(eta_1) < cut_photon_eta_max && (std::fabs(eta_1) < cut_photon_eta_crack_low || std::fabs(eta_1) > cut_photon_eta_crack_high)) && 
+           (std::fabs(eta_2) < cut_photon_eta_max && (std::fabs(eta_2) < cut_photon_eta_crack_low || std::fabs(eta_2) > cut_photon_eta_crack_high));
+}
+
+bool HistMaker::PassTriggerPt(float pt_1, float pt_2)
+{
+    return pt_1 > cut_photon_1_pt && pt_2 > cut_photon_2_pt;
+}
+
+bool HistMaker::PassPtOverMass(float pt_1, float pt_2, float mass)
+{
+    return pt_1/mass > cut_photon_1_pt_over_m && pt_2/mass > cut_photon_2_pt_over_m;
+}
+
+void HistMaker::EventLooper(TChain* chain, TFile *outHists, bool isData)
+{
+    ///
+    // TODO
+    //
+
+    BookHists(outHists);
+
+    if (storeSkim)
+    {
+        skimNames.assign(eventColumns.begin(), eventColumns.end());
+        skimNames.push_back("weight");
+        skimColumns.clear();
+        for (auto name : skimNames) skimColumns[name] = {};
+        if (nThreads > 1)
+        {
+            std::cerr << "the skim columns are only stored when running on one thread, so not using " << nThreads << " threads." << std::endl;
+            nThreads = 1;
+        }
+    }
+
+    if (nBootstrap > 0)
+    {
+        if (nThreads > 1)
+        {
+            std::cerr << "the bootstrap replicas are only filled when running on one thread, so not using " << nThreads << " threads." << std::endl;
+            nThreads = 1;
+        }
+        bootstrapWeights = new BootstrapWeights(nBootstrap);
+        for (auto hist : registeredHists)
+        {
+            bootstraps[hist] = new BootstrapHist1D(hist, nBootstrap);
+            fillers[hist->GetUniqueID()].bootstrap = bootstraps[hist];
+        }
+        std::cout << "Filling " << nBootstrap << " bootstrap replicas of each histogram." << std::endl;
+    }
+
+    TFile* cacheFile = nullptr;
+    if (!cutCachePath.empty())
+    {
+        if (nThreads > 1 || reproducible)
+        {
+            std::cerr << "the cut cache is written in entry order on one thread, so turning off the threaded/reproducible mode." << std::endl;
+            nThreads = 1;
+            reproducible = false;
+        }
+        cacheFile = OpenCutCache(cutCachePath);
+    }
+
+    if (!checkpointPath.empty() && (cacheFile || storeSkim))
+    {
+        std::cerr << "the cut cache and skim columns can't be checkpointed, so not writing checkpoints." << std::endl;
+        checkpointPath = "";
+    }
+
     HistMaker::Init(chain);
 
     
     Long64_t nentries = GetNEvents();
     std::cout << "There are " << nentries << " events in the TTree" << std::endl;
 
+    lastCheckpointEntries = 0;
+    lastCheckpointTime = std::chrono::steady_clock::now();
+    std::vector<char> chunksDone;
 
-    for (Long64_t entry=0; entry<nentries; entry++)
+    if (!reproducible && nThreads <= 1)
+    {
+        Long64_t first = (resume && !checkpointPath.empty()) ? ReadCheckpoint(chunksDone, isData) : 0;
+        ProcessEntries(first, nentries, isData);
+    }
+    else
+    {
+        // Fixed chunks of entries, each summed on its own and merged in chunk order as they finish.
+        // Which thread processes a chunk doesn't change its sums, so the output is the same for any number of threads.
+        Long64_t nchunks = (nentries + chunkSize - 1)/chunkSize;
+        std::vector<ReproducibleHist1D*> chunkedHists;
+        for (auto hist : registeredHists)
+        {
+            chunkedHists.push_back(new ReproducibleHist1D(hist, nchunks));
+            accumulators[hist] = chunkedHists.back();
+            fillers[hist->GetUniqueID()].accumulator = chunkedHists.back();
+        }
+
+        // a checkpoint holds the chunks finished so far, on resuming only the others are processed.
+        chunksDone.assign(nchunks, 0);
+        Long64_t entriesDone = 0;
+        if (resume && !checkpointPath.empty()) entriesDone = ReadCheckpoint(chunksDone, isData);
+
+        if (nThreads <= 1)
+        {
+            for (Long64_t chunk=0; chunk<nchunks; chunk++)
+            {
+                if (chunksDone[chunk]) continue;
+                StartChunk();
+                Long64_t last = std::min((chunk+1)*chunkSize, nentries);
+                ProcessEntries(chunk*chunkSize, last, isData);
+                FinishChunk(chunk);
+                chunksDone[chunk] = 1;
+                entriesDone += last - chunk*chunkSize;
+                if (!checkpointPath.empty() && CheckpointDue(entriesDone)) WriteCheckpoint(0, entriesDone, isData);
+            }
+        }
+        else
+        {
+            std::cout << "Running on " << nThreads << " threads, in " << nchunks << " chunks of " << chunkSize << " events." << std::endl;
+            ROOT::EnableThreadSafety();
+            std::vector<char> resumedChunks = chunksDone;
+            // the threads take the chunks in order as they become free. A chunk that finishes before the ones ahead
+            // of it is held until they are merged, so a thread waits before going more than maxAhead chunks past the
+            // first unfinished one: at most that many chunks are held, however long the input.
+            std::atomic<Long64_t> nextChunk(0);
+            Long64_t firstUnfinished = 0;
+            while (firstUnfinished < nchunks && chunksDone[firstUnfinished]) firstUnfinished++;
+            const Long64_t maxAhead = 2*nThreads;
+            std::mutex chunksMutex;
+            std::condition_variable chunkFinished;
+            std::atomic<int> nRunning(nThreads);
+            std::vector<std::thread> threads;
+            for (int ithread=0; ithread<nThreads; ithread++)
+            {
+                threads.push_back(std::thread([&]()
+                {
+                    // each thread needs its own chain and branch addresses to read into.
+                    TChain* threadChain = new TChain(chain->GetName(), "");
+                    threadChain->Add(chain);
+                    HistMaker worker{HistMaker::NoChain()};
+                    worker.Init(threadChain);
+                    worker.ShareSettings(*this);
+                    for (Long64_t chunk=nextChunk++; chunk<nchunks; chunk=nextChunk++)
+                    {
+                        if (resumedChunks[chunk]) continue;
+                        {
+                            // the first unfinished chunk is always being processed, so this can't wait forever.
+                            std::unique_lock<std::mutex> lock(chunksMutex);
+                            chunkFinished.wait(lock, [&]() { return chunk < firstUnfinished + maxAhead; });
+                        }
+                        worker.StartChunk();
+                        Long64_t last = std::min((chunk+1)*chunkSize, nentries);
+                        worker.ProcessEntries(chunk*chunkSize, last, isData);
+                        {
+                            std::lock_guard<std::mutex> lock(chunksMutex);
+                            worker.FinishChunk(chunk);
+                            chunksDone[chunk] = 1;
+                            entriesDone += last - chunk*chunkSize;
+                            while (firstUnfinished < nchunks && chunksDone[firstUnfinished]) firstUnfinished++;
+                        }
+                        chunkFinished.notify_all();
+                    }
+                    delete threadChain;
+                    nRunning--;
+                }));
+            }
+            // the accumulators only change when a chunk finishes, under the lock, so holding it while writing the
+            // checkpoint saves a consistent state while the threads carry on filling their chunks.
+            while (!checkpointPath.empty() && nRunning > 0)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                std::lock_guard<std::mutex> lock(chunksMutex);
+                if (nRunning > 0 && CheckpointDue(entriesDone)) WriteCheckpoint(0, entriesDone, isData);
+            }
+            for (auto& thread : threads) thread.join();
+        }
+
+        for (auto chunkedHist : chunkedHists)
+        {
+            chunkedHist->WriteToHist();
+            delete chunkedHist;
+        }
+        accumulators.clear();
+        chunkSums.clear();
+        for (auto& filler : fillers) filler.accumulator = nullptr;
+    }
+
+    if (cacheFile) CloseCutCache(cacheFile, isData);
+    ResetVariableBinStats();
+
+    bootstrapHists.clear();
+    for (auto bootstrap : bootstraps)
+    {
+        bootstrapHists.push_back(bootstrap.second->MakeHist2D(outHists));
+        delete bootstrap.second;
+    }
+    bootstraps.clear();
+    for (auto& filler : fillers) filler.bootstrap = nullptr;
+    delete bootstrapWeights;
+    bootstrapWeights = nullptr;
+
+    // write histograms to root file for further analysis.
+    if (outHists)
+    {
+        outHists->Write();
+        outHists->Close();
+    }
+
+    // the job finished, so there's nothing left to resume.
+    if (!checkpointPath.empty()) std::remove(checkpointPath.c_str());
+
+}
+
+void HistMaker::ShareSettings(const HistMaker& other)
+{
+    // copy the selection settings and the output histograms (and their accumulators) of another HistMaker,
+    // so this one can process part of the same job.
+    luminosity_ifb = other.luminosity_ifb;
+    cut_photon_eta_max = other.cut_photon_eta_max;
+    cut_photon_eta_crack_low = other.cut_photon_eta_crack_low;
+    cut_photon_eta_crack_high = other.cut_photon_eta_crack_high;
+    cut_photon_1_pt = other.cut_photon_1_pt;
+    cut_photon_2_pt = other.cut_photon_2_pt;
+    cut_photon_1_pt_over_m = other.cut_photon_1_pt_over_m;
+    cut_photon_2_pt_over_m = other.cut_photon_2_pt_over_m;
+
+    hist_pTGam_1 = other.hist_pTGam_1;
+    hist_pTGam_2 = other.hist_pTGam_2;
+    hist_EGam_1 = other.hist_EGam_1;
+    hist_EGam_2 = other.hist_EGam_2;
+    hist_etaGam_1 = other.hist_etaGam_1;
+    hist_etaGam_2 = other.hist_etaGam_2;
+    hist_phiGam_1 = other.hist_phiGam_1;
+    hist_phiGam_2 = other.hist_phiGam_2;
+    hist_mGamGam = other.hist_mGamGam;
+    hist_cutflow = other.hist_cutflow;
+    accumulators = other.accumulators;
+    // the fillers point at the other HistMaker's lookups and accumulators, which it keeps until we're done.
+    fillers = other.fillers;
+}
+
+void HistMaker::StartChunk()
+{
+    // zero this HistMaker's sums of the histograms with accumulators, ready to fill the next chunk.
+    chunkSums.resize(fillers.size());
+    for (size_t id=0; id<fillers.size(); id++)
+    {
+        if (fillers[id].accumulator) chunkSums[id].Reset(fillers[id].accumulator->NCells());
+    }
+}
+
+void HistMaker::FinishChunk(Long64_t chunk)
+{
+    // hand the sums of the chunk just processed to the accumulators, which are shared by all the threads.
+    for (size_t id=0; id<fillers.size(); id++)
+    {
+        if (fillers[id].accumulator) fillers[id].accumulator->FinishChunk(chunk, chunkSums[id]);
+    }
+}
+
+void HistMaker::FillHist(TH1D* hist, double x, double w)
+{
+    // fill directly, or into the current chunk when running in reproducible mode, and into any bootstrap replicas.
+    const HistFiller& filler = fillers[hist->GetUniqueID()];
+    if (!filler.lookup && !filler.accumulator && !filler.bootstrap)
+    {
+        hist->Fill(x, w);
+        return;
+    }
+
+    // find the bin once, with the lookup table for variable bins, as TH1::Fill would do a binary search over the edges.
+    // FindFixBin never extends the axis, so it's safe to call from several threads.
+    int bin = filler.lookup ? filler.lookup->FindBin(x) : hist->GetXaxis()->FindFixBin(x);
+    if (filler.accumulator)
+    {
+        chunkSums[hist->GetUniqueID()].Fill(bin, w);
+    }
+    else if (filler.lookup)
+    {
+        hist->AddBinContent(bin, w);
+        hist->GetSumw2()->fArray[bin] += w*w;
+        hist->SetEntries(hist->GetEntries() + 1);
+    }
+    else
     {
+        hist->Fill(x, w);
+    }
+    if (filler.bootstrap) filler.bootstrap->FillBin(bin, w, bootstrapWeights->weights.data());
+}
+
+void HistMaker::ProcessEntries(Long64_t first, Long64_t last, bool isData)
+{
+    // run the selection over the entries [first, last) and fill the histograms.
+    Long64_t nentries = fChain->GetEntries();
+
+    for (Long64_t entry=first; entry<last; entry++)
+    {
+        // outside reproducible mode everything before this entry is already in the histograms, so we can checkpoint here.
+        if (!checkpointPath.empty() && accumulators.empty() && entry > first && CheckpointDue(entry))
+        {
+            WriteCheckpoint(entry, entry, isData);
+        }
+
         // some printout to track progress
         if (entry%5000 == 0)
         {
@@ -146,69 +538,450 @@ void HistMaker::EventLooper(TChain* chain, TFile *outHists, bool isData)
 
         // read the entry from the ntuple
         fChain->GetEntry(entry);
+        if (bootstrapWeights) bootstrapWeights->Generate(runNumber, eventNumber);
 
         // read in the event weight
         float histoweight = 1.0;
-        if (!isData) 
+        if (!isData) histoweight = EventWeight(mcWeight, xsec_ipb, sumWeights, pileupSF, luminosity_ifb);
+
+        ProcessEvent(photon_pt->data(), photon_E->data(), photon_eta->data(), photon_phi->data(), photon_pt->size(), histoweight);
+    }
+
+}
+
+float HistMaker::EventWeight(Float_t weight_mc, Float_t xsec, Float_t sumw, Float_t sf_pileup, float luminosity_ifb)
+{
+    // MC event weighting to luminosity of data
+    float histoweight = weight_mc * xsec *1000. * luminosity_ifb / sumw;
+    // MC weight corrections for experimental effects
+    histoweight = histoweight * sf_pileup;
+    // TODO multiply by the photon scale factor weight
+    return histoweight;
+}
+
+void HistMaker::ProcessEvent(const Float_t* photon_pt, const Float_t* photon_E, const Float_t* photon_eta, const Float_t* photon_phi,
+                             size_t nphotons, float histoweight)
+{
+    // the selection and histogram filling for one event, given its photons (in MeV, as in the ntuple) and weight.
+    FillHist(hist_cutflow, 0, histoweight);
+    if (cutCache)
+    {
+        cacheSumwAll += histoweight;
+        cacheSumw2All += double(histoweight)*histoweight;
+        cacheNAll++;
+    }
+
+    // Need events that have at least 2 photons in to start with.
+    // Note we are formating this as "if fail requirement exit and move to the next event in the loop". "if pass opposite-to-requirement" is also fine but I find this more readable in this scenario in terms of what requirements we do want.
+    if (!(nphotons >= 2)) return;
+    FillHist(hist_cutflow, 1, histoweight);
+    
+    // Obtain the kinematic variables (note TTree is in MeV and I want GeV)
+    float photon_1_pt = photon_pt[0]*0.001;
+    float photon_2_pt = photon_pt[1]*0.001;
+    float photon_1_E = photon_E[0]*0.001;
+    float photon_2_E = photon_E[1]*0.001;
+    float photon_1_eta = photon_eta[0];
+    float photon_2_eta = photon_eta[1];
+    float photon_1_phi = photon_phi[0];
+    float photon_2_phi = photon_phi[1];
+
+    ROOT::Math::PtEtaPhiEVector photon_1_p4(photon_1_pt, photon_1_eta, photon_1_phi, photon_1_E);
+    ROOT::Math::PtEtaPhiEVector photon_2_p4(photon_2_pt, photon_2_eta, photon_2_phi, photon_2_E);
+
+    float diphoton_mass = (photon_1_p4 + photon_2_p4).M();
+
+    // save which cuts this event passes, and what they depend on, so we can redo the selection later without the ntuple.
+    if (cutCache)
+    {
+        cacheEntry.mask = (1u << kCut2Photons);
+        if (PassFiducial(photon_1_eta, photon_2_eta)) cacheEntry.mask |= (1u << kCutFiducial);
+        if (PassTriggerPt(photon_1_pt, photon_2_pt)) cacheEntry.mask |= (1u << kCutTriggerPt);
+        if (nphotons == 2) cacheEntry.mask |= (1u << kCutExactly2Photons);
+        if (PassPtOverMass(photon_1_pt, photon_2_pt, diphoton_mass)) cacheEntry.mask |= (1u << kCutPtOverMass);
+        cacheEntry.weight = histoweight;
+        cacheEntry.values[kColPhotonPt1] = photon_1_pt;
+        cacheEntry.values[kColPhotonPt2] = photon_2_pt;
+        cacheEntry.values[kColPhotonE1] = photon_1_E;
+        cacheEntry.values[kColPhotonE2] = photon_2_E;
+        cacheEntry.values[kColPhotonEta1] = photon_1_eta;
+        cacheEntry.values[kColPhotonEta2] = photon_2_eta;
+        cacheEntry.values[kColPhotonPhi1] = photon_1_phi;
+        cacheEntry.values[kColPhotonPhi2] = photon_2_phi;
+        cacheEntry.values[kColDiphotonMass] = diphoton_mass;
+        cutCache->Fill();
+    }
+
+    // Need to check the photons are in the fiducial region
+    if (!PassFiducial(photon_1_eta, photon_2_eta)) return;
+    FillHist(hist_cutflow, 2, histoweight);
+
+    // We need to apply the photon trigger requirements, approximated by requiring our photons to have photon 1(2) pT > 35(25) GeV
+    if (!PassTriggerPt(photon_1_pt, photon_2_pt)) return;
+    FillHist(hist_cutflow, 3, histoweight);
+
+
+    // TODO we're also only interested in the case where our two photons have passed a Tight particle ID, to reduce misreconstruction backgrounds.
+    // Can you use the boolean "photon_isTightID" vector branch to require this?..
+
+    // Only interested in events that have exactly 2 photons in that pass those requirements.
+    if (!(nphotons == 2)) return;
+    FillHist(hist_cutflow, 4, histoweight);
+
+    // Another requirement for the events is a pT/diphoton mass bound
+    if (!PassPtOverMass(photon_1_pt, photon_2_pt, diphoton_mass)) return;
+    FillHist(hist_cutflow, 5, histoweight);
+
+    // Fill the histograms in the output file with the event values.
+    FillHist(hist_pTGam_1, photon_1_pt, histoweight);
+    FillHist(hist_pTGam_2, photon_2_pt, histoweight);
+    FillHist(hist_EGam_1, photon_1_E, histoweight);
+    FillHist(hist_EGam_2, photon_2_E, histoweight);
+    FillHist(hist_etaGam_1, photon_1_eta, histoweight);
+    FillHist(hist_etaGam_2, photon_2_eta, histoweight);
+    FillHist(hist_phiGam_1, photon_1_phi, histoweight);
+    FillHist(hist_phiGam_2, photon_2_phi, histoweight);
+    FillHist(hist_mGamGam, diphoton_mass, histoweight);
+
+    if (storeSkim)
+    {
+        skimColumns["photon_pt_1"].push_back(photon_1_pt);
+        skimColumns["photon_pt_2"].push_back(photon_2_pt);
+        skimColumns["photon_E_1"].push_back(photon_1_E);
+        skimColumns["photon_E_2"].push_back(photon_2_E);
+        skimColumns["photon_eta_1"].push_back(photon_1_eta);
+        skimColumns["photon_eta_2"].push_back(photon_2_eta);
+        skimColumns["photon_phi_1"].push_back(photon_1_phi);
+        skimColumns["photon_phi_2"].push_back(photon_2_phi);
+        skimColumns["diphoton_mass"].push_back(diphoton_mass);
+        skimColumns["weight"].push_back(histoweight);
+    }
+
+}
+
+TFile* HistMaker::OpenCutCache(std::string path)
+{
+    // create the cut cache file and its tree, the EventLooper fills one entry per event with at least 2 photons.
+    TFile* cacheFile = TFile::Open(path.c_str(), "RECREATE");
+    if (!cacheFile || cacheFile->IsZombie()) throw std::runtime_error("couldn't create the cut cache "+path);
+    cutCache = new TTree("cutcache", "per-event cut mask, weight and kinematics");
+    cutCache->SetDirectory(cacheFile);
+    cutCache->Branch("mask", &cacheEntry.mask, "mask/i");
+    cutCache->Branch("weight", &cacheEntry.weight, "weight/F");
+    for (size_t i=0; i<kNEventColumns; i++)
+    {
+        cutCache->Branch(eventColumns[i].c_str(), &cacheEntry.values[i], (eventColumns[i]+"/F").c_str());
+    }
+    cacheSumwAll = 0.;
+    cacheSumw2All = 0.;
+    cacheNAll = 0;
+    std::cout << "Writing the cut cache to " << path << std::endl;
+    return cacheFile;
+}
+
+void HistMaker::CloseCutCache(TFile* cacheFile, bool isData)
+{
+    // save the tree along with the settings it was made with and the weights of the events that never made it in.
+    cacheFile->cd();
+    cutCache->Write();
+    for (auto setting : CutSettings())
+    {
+        TParameter<float> param(("cut_"+setting.first).c_str(), *setting.second);
+        param.Write();
+    }
+    TParameter<int>("isData", isData).Write();
+    TParameter<double>("sumw_all", cacheSumwAll).Write();
+    TParameter<double>("sumw2_all", cacheSumw2All).Write();
+    TParameter<Long64_t>("n_all", cacheNAll).Write();
+    cacheFile->Close();
+    delete cacheFile;
+    cutCache = nullptr;
+}
+
+void HistMaker::ReadCutCache(std::string path, CutCacheColumns& cache, std::vector<UInt_t>& masks, std::vector<Float_t>& floats)
+{
+    // read a whole cut cache file into memory: masks gets the cut masks, floats the weight column followed by
+    // each of the eventColumns, and cache is set up to point at them along with the settings the cache was made with.
+    TFile* cacheFile = TFile::Open(path.c_str(), "READ");
+    if (!cacheFile || cacheFile->IsZombie()) throw std::runtime_error("couldn't open the cut cache "+path);
+    TTree* tree = cacheFile->Get<TTree>("cutcache");
+    if (!tree) throw std::runtime_error(path+" doesn't contain a cut cache");
+
+    for (auto setting : CutSettings())
+    {
+        TParameter<float>* cached = cacheFile->Get<TParameter<float>>(("cut_"+setting.first).c_str());
+        if (!cached) throw std::runtime_error(path+" has no setting for "+setting.first);
+        cache.settings[setting.first] = cached->GetVal();
+    }
+    TParameter<int>* isData = cacheFile->Get<TParameter<int>>("isData");
+    TParameter<double>* sumwAll = cacheFile->Get<TParameter<double>>("sumw_all");
+    TParameter<double>* sumw2All = cacheFile->Get<TParameter<double>>("sumw2_all");
+    TParameter<Long64_t>* nAll = cacheFile->Get<TParameter<Long64_t>>("n_all");
+    if (!isData || !sumwAll || !sumw2All || !nAll) throw std::runtime_error(path+" is missing the totals of the cut cache");
+    cache.isData = isData->GetVal();
+    cache.sumwAll = sumwAll->GetVal();
+    cache.sumw2All = sumw2All->GetVal();
+    cache.nAll = nAll->GetVal();
+
+    tree->SetBranchAddress("mask", &cacheEntry.mask);
+    tree->SetBranchAddress("weight", &cacheEntry.weight);
+    for (size_t i=0; i<kNEventColumns; i++) tree->SetBranchAddress(eventColumns[i].c_str(), &cacheEntry.values[i]);
+
+    Long64_t nentries = tree->GetEntries();
+    masks.resize(nentries);
+    floats.resize(nentries*(1 + kNEventColumns));
+    for (Long64_t entry=0; entry<nentries; entry++)
+    {
+        tree->GetEntry(entry);
+        masks[entry] = cacheEntry.mask;
+        floats[entry] = cacheEntry.weight;
+        for (size_t i=0; i<kNEventColumns; i++) floats[(i+1)*nentries + entry] = cacheEntry.values[i];
+    }
+    cacheFile->Close();
+    delete cacheFile;
+
+    cache.nevents = nentries;
+    cache.mask = masks.data();
+    cache.weight = floats.data();
+    for (size_t i=0; i<kNEventColumns; i++) cache.values[i] = floats.data() + (i+1)*nentries;
+}
+
+void HistMaker::FillFromCutCache(const CutCacheColumns& cache)
+{
+    ///
+    // Redo the selection on the events of a cut cache with the current settings and fill the (already booked) histograms.
+    // Only the cuts whose settings differ from the ones the cache was made with are evaluated again, the rest come
+    // straight from the cached mask. With unchanged settings the bin contents, errors and entries are identical to the
+    // original run; the cutflow mean/rms are summed in a different order, so only agree up to rounding.
+    //
+    std::map<std::string, bool> changed;
+    for (auto setting : CutSettings())
+    {
+        changed[setting.first] = (cache.settings.at(setting.first) != *setting.second);
+        if (changed[setting.first]) std::cout << "Cut " << setting.first << " changed from " << cache.settings.at(setting.first) << " to " << *setting.second << std::endl;
+    }
+    bool redoFiducial = changed["photon_eta_max"] || changed["photon_eta_crack_low"] || changed["photon_eta_crack_high"];
+    bool redoTriggerPt = changed["photon_1_pt"] || changed["photon_2_pt"];
+    bool redoPtOverMass = changed["photon_1_pt_over_m"] || changed["photon_2_pt_over_m"];
+
+    // the MC weights are proportional to the luminosity, so rescale them if that changed.
+    float weightScale = (cache.isData || !changed["luminosity_ifb"]) ? 1. : luminosity_ifb/cache.settings.at("luminosity_ifb");
+
+    const std::array<const Float_t*, kNEventColumns>& v = cache.values;
+    for (Long64_t entry=0; entry<cache.nevents; entry++)
+    {
+        UInt_t mask = cache.mask[entry];
+        if (redoFiducial)
         {
-            // MC event weighting to luminosity of data
-            histoweight = mcWeight * xsec_ipb *1000. * luminosity_ifb / sumWeights;
-            // MC weight corrections for experimental effects
-            histoweight = histoweight * pileupSF;
-            // TODO multiply by the photon scale factor weight
+            mask &= ~(1u << kCutFiducial);
+            if (PassFiducial(v[kColPhotonEta1][entry], v[kColPhotonEta2][entry])) mask |= (1u << kCutFiducial);
+        }
+        if (redoTriggerPt)
+        {
+            mask &= ~(1u << kCutTriggerPt);
+            if (PassTriggerPt(v[kColPhotonPt1][entry], v[kColPhotonPt2][entry])) mask |= (1u << kCutTriggerPt);
+        }
+        if (redoPtOverMass)
+        {
+            mask &= ~(1u << kCutPtOverMass);
+            if (PassPtOverMass(v[kColPhotonPt1][entry], v[kColPhotonPt2][entry], v[kColDiphotonMass][entry])) mask |= (1u << kCutPtOverMass);
         }
 
-        // Need events that have at least 2 photons in to start with.
-        // Note we are formating this as "if fail requirement exit and move to the next event in the loop". "if pass opposite-to-requirement" is also fine but I find this more readable in this scenario in terms of what requirements we do want.
-        if (!(photon_pt->size() >= 2)) continue;
-        
-        // Obtain the kinematic variables (note TTree is in MeV and I want GeV)
-        float photon_1_pt = photon_pt->at(0)*0.001;
-        float photon_2_pt = photon_pt->at(1)*0.001;
-        float photon_1_E = photon_E->at(0)*0.001;
-        float photon_2_E = photon_E->at(1)*0.001;
-        float photon_1_eta = photon_eta->at(0);
-        float photon_2_eta = photon_eta->at(1);
-        float photon_1_phi = photon_phi->at(0);
-        float photon_2_phi = photon_phi->at(1);
-
-        // Need to check the photons are in the fiducial region
-        if (!((std::fabs(photon_1_eta) < 2.37 && (std::fabs(photon_1_eta) < 1.37 || std::fabs(photon_1_eta) > 1.56)) && 
-            (std::fabs(photon_2_eta) < 2.37 && (std::fabs(photon_2_eta) < 1.37 || std::fabs(photon_2_eta) > 1.56)))) continue;
+        float histoweight = cache.weight[entry];
+        if (weightScale != 1.) histoweight = histoweight * weightScale;
+
+        // same order as in ProcessEntries, every cached event passed the 2 photon requirement.
+        FillHist(hist_cutflow, 1, histoweight);
+        if (!(mask & (1u << kCutFiducial))) continue;
+        FillHist(hist_cutflow, 2, histoweight);
+        if (!(mask & (1u << kCutTriggerPt))) continue;
+        FillHist(hist_cutflow, 3, histoweight);
+        if (!(mask & (1u << kCutExactly2Photons))) continue;
+        FillHist(hist_cutflow, 4, histoweight);
+        if (!(mask & (1u << kCutPtOverMass))) continue;
+        FillHist(hist_cutflow, 5, histoweight);
+
+        FillHist(hist_pTGam_1, v[kColPhotonPt1][entry], histoweight);
+        FillHist(hist_pTGam_2, v[kColPhotonPt2][entry], histoweight);
+        FillHist(hist_EGam_1, v[kColPhotonE1][entry], histoweight);
+        FillHist(hist_EGam_2, v[kColPhotonE2][entry], histoweight);
+        FillHist(hist_etaGam_1, v[kColPhotonEta1][entry], histoweight);
+        FillHist(hist_etaGam_2, v[kColPhotonEta2][entry], histoweight);
+        FillHist(hist_phiGam_1, v[kColPhotonPhi1][entry], histoweight);
+        FillHist(hist_phiGam_2, v[kColPhotonPhi2][entry], histoweight);
+        FillHist(hist_mGamGam, v[kColDiphotonMass][entry], histoweight);
+    }
 
-        // We need to apply the photon trigger requirements, approximated by requiring our photons to have photon 1(2) pT > 35(25) GeV
-        if (!(photon_1_pt > 35. && photon_2_pt > 25.)) continue;
+    ResetVariableBinStats();
+
+    // the "all" cutflow bin includes the events that never made it into the cache. SetBinContent resets the stats
+    // and counts an entry, so keep them and add the "all" fills (all at x = 0) to them ourselves.
+    double entriesBefore = hist_cutflow->GetEntries();
+    double stats[4];
+    hist_cutflow->GetStats(stats);
+    stats[0] += cache.sumwAll*weightScale;
+    stats[1] += cache.sumw2All*weightScale*weightScale;
+    hist_cutflow->SetBinContent(1, cache.sumwAll*weightScale);
+    hist_cutflow->GetSumw2()->SetAt(cache.sumw2All*weightScale*weightScale, 1);
+    hist_cutflow->PutStats(stats);
+    hist_cutflow->SetEntries(entriesBefore + cache.nAll);
+}
 
+void HistMaker::RefillFromCache(std::string path, TFile* outHists)
+{
+    // redo the selection and fill the histograms from a cut cache made by an earlier EventLooper run.
+    // The cache only has the events, so the options of the EventLooper's own loop over them can't be honoured here.
+    if (nBootstrap > 0) throw std::runtime_error("the bootstrap replicas need the run and event numbers, which aren't in the cut cache");
+    if (nThreads > 1 || reproducible) throw std::runtime_error("refilling from a cut cache only runs on one thread, not in the threaded/reproducible mode");
+    if (!checkpointPath.empty() || resume) throw std::runtime_error("refilling from a cut cache can't be checkpointed or resumed");
+    if (!cutCachePath.empty()) throw std::runtime_error("can't write a new cut cache while refilling from one");
+    auto start = std::chrono::steady_clock::now();
+    BookHists(outHists);
+
+    CutCacheColumns cache;
+    std::vector<UInt_t> masks;
+    std::vector<Float_t> floats;
+    ReadCutCache(path, cache, masks, floats);
+    FillFromCutCache(cache);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Refilled the histograms from " << cache.nevents << " cached events in " << seconds << " s." << std::endl;
+
+    if (outHists)
+    {
+        outHists->Write();
+        outHists->Close();
+    }
+}
 
-        // TODO we're also only interested in the case where our two photons have passed a Tight particle ID, to reduce misreconstruction backgrounds.
-        // Can you use the boolean "photon_isTightID" vector branch to require this?..
+bool HistMaker::CheckpointDue(Long64_t entriesDone)
+{
+    // whether checkpointEvents events or checkpointSeconds seconds have gone by since the last checkpoint.
+    if (checkpointEvents > 0 && entriesDone - lastCheckpointEntries >= checkpointEvents) return true;
+    if (checkpointSeconds <= 0.) return false;
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - lastCheckpointTime).count();
+    return seconds >= checkpointSeconds;
+}
 
-        // Only interested in events that have exactly 2 photons in that pass those requirements.
-        if (!(photon_pt->size() == 2)) continue;
+void HistMaker::WriteCheckpoint(Long64_t nextEntry, Long64_t entriesDone, bool isData)
+{
+    ///
+    // Save the state of the event loop to checkpointPath: the histograms filled so far and the first entry still to do,
+    // or in reproducible mode the state of the chunk accumulators. Along with the settings, so we only resume the same job.
+    //
+    std::string tmpPath = checkpointPath + ".tmp";
+    TFile* file = TFile::Open(tmpPath.c_str(), "RECREATE");
+    if (!file || file->IsZombie())
+    {
+        std::cerr << "couldn't write the checkpoint " << tmpPath << ", carrying on without it." << std::endl;
+        delete file;
+        lastCheckpointTime = std::chrono::steady_clock::now();
+        return;
+    }
 
-        ROOT::Math::PtEtaPhiEVector photon_1_p4(photon_1_pt, photon_1_eta, photon_1_phi, photon_1_E);
-        ROOT::Math::PtEtaPhiEVector photon_2_p4(photon_2_pt, photon_2_eta, photon_2_phi, photon_2_E);
+    TParameter<Long64_t>("nentries", fChain->GetEntries()).Write();
+    TParameter<Long64_t>("next_entry", nextEntry).Write();
+    TParameter<Long64_t>("entries_done", entriesDone).Write();
+    TParameter<Long64_t>("chunk_size", accumulators.empty() ? 0 : chunkSize).Write();
+    TParameter<int>("isData", isData).Write();
+    TParameter<int>("nBootstrap", nBootstrap).Write();
+    for (auto setting : CutSettings()) TParameter<float>(("cut_"+setting.first).c_str(), *setting.second).Write();
 
-        float diphoton_mass = (photon_1_p4 + photon_2_p4).M();
+    if (accumulators.empty())
+    {
+        for (auto hist : registeredHists) file->WriteTObject(hist, hist->GetName());
+    }
+    else
+    {
+        for (auto hist : registeredHists) accumulators.at(hist)->SaveChunks(file);
+    }
+    for (auto bootstrap : bootstraps) bootstrap.second->Save(file);
+    file->Close();
+    delete file;
 
-        // Another requirement for the events is a pT/diphoton mass bound
-        if (!(photon_1_pt/diphoton_mass > 0.35 && photon_2_pt/diphoton_mass > 0.25)) continue;
+    // the rename replaces the old checkpoint in one go, so a crash leaves either the old one or the new one.
+    if (std::rename(tmpPath.c_str(), checkpointPath.c_str()) != 0)
+    {
+        std::cerr << "couldn't move the checkpoint to " << checkpointPath << std::endl;
+    }
+    else
+    {
+        std::cout << "Checkpoint after " << entriesDone << " events written to " << checkpointPath << std::endl;
+    }
+    lastCheckpointEntries = entriesDone;
+    lastCheckpointTime = std::chrono::steady_clock::now();
+}
 
-        // Fill the histograms in the output file with the event values.
-        hist_pTGam_1->Fill(photon_1_pt, histoweight);
-        hist_pTGam_2->Fill(photon_2_pt, histoweight);
-        hist_EGam_1->Fill(photon_1_E, histoweight);
-        hist_EGam_2->Fill(photon_2_E, histoweight);
-        hist_etaGam_1->Fill(photon_1_eta, histoweight);
-        hist_etaGam_2->Fill(photon_2_eta, histoweight);
-        hist_phiGam_1->Fill(photon_1_phi, histoweight);
-        hist_phiGam_2->Fill(photon_2_phi, histoweight);
-        hist_mGamGam->Fill(diphoton_mass, histoweight);
+Long64_t HistMaker::ReadCheckpoint(std::vector<char>& chunksDone, bool isData)
+{
+    ///
+    // Restore the state saved by WriteCheckpoint into the freshly booked histograms (or the chunk accumulators in
+    // reproducible mode, marking the restored chunks in chunksDone). Returns the first entry still to process,
+    // or in reproducible mode the number of entries done. Starts from scratch if there's no checkpoint yet.
+    //
+    TFile* file = TFile::Open(checkpointPath.c_str(), "READ");
+    if (!file || file->IsZombie())
+    {
+        std::cerr << "no checkpoint " << checkpointPath << " to resume from, starting from the beginning." << std::endl;
+        delete file;
+        return 0;
+    }
 
+    // only resume a checkpoint of the same job, as anything else would silently give wrong histograms.
+    // Missing parameters (a foreign or truncated file) fail the same checks.
+    auto check = [&](bool ok, std::string what)
+    {
+        if (!ok) throw std::runtime_error("can't resume from "+checkpointPath+", it doesn't match this job: "+what);
+    };
+    TParameter<Long64_t>* savedEntries = file->Get<TParameter<Long64_t>>("nentries");
+    TParameter<int>* savedIsData = file->Get<TParameter<int>>("isData");
+    TParameter<Long64_t>* savedChunkSize = file->Get<TParameter<Long64_t>>("chunk_size");
+    TParameter<int>* savedBootstrap = file->Get<TParameter<int>>("nBootstrap");
+    TParameter<Long64_t>* savedNextEntry = file->Get<TParameter<Long64_t>>("next_entry");
+    TParameter<Long64_t>* savedEntriesDone = file->Get<TParameter<Long64_t>>("entries_done");
+    check(savedEntries && savedEntries->GetVal() == fChain->GetEntries(), "input");
+    check(savedIsData && savedIsData->GetVal() == isData, "sample type");
+    check(savedChunkSize && savedChunkSize->GetVal() == (accumulators.empty() ? 0 : chunkSize), "reproducible mode or chunk size");
+    check(savedBootstrap && savedBootstrap->GetVal() == nBootstrap, "number of bootstrap replicas");
+    check(savedNextEntry && savedEntriesDone, "entries done");
+    for (auto setting : CutSettings())
+    {
+        TParameter<float>* saved = file->Get<TParameter<float>>(("cut_"+setting.first).c_str());
+        check(saved && saved->GetVal() == *setting.second, "setting for "+setting.first);
     }
 
-    // write histograms to root file for further analysis.
-    outHists->Write();
-    outHists->Close();
+    Long64_t nextEntry = savedNextEntry->GetVal();
+    Long64_t entriesDone = savedEntriesDone->GetVal();
+    if (accumulators.empty())
+    {
+        // copy the contents, errors and statistics over, continuing to fill then gives exactly the same sums.
+        for (auto hist : registeredHists)
+        {
+            TH1D* saved = file->Get<TH1D>(hist->GetName());
+            check(saved && saved->GetNcells() == hist->GetNcells(), "binning of "+std::string(hist->GetName()));
+            for (int bin=0; bin<hist->GetNcells(); bin++)
+            {
+                hist->SetBinContent(bin, saved->GetBinContent(bin));
+                hist->GetSumw2()->fArray[bin] = saved->GetSumw2()->fArray[bin];
+            }
+            double stats[4];
+            saved->GetStats(stats);
+            hist->PutStats(stats);
+            hist->SetEntries(saved->GetEntries());
+            delete saved;
+        }
+    }
+    else
+    {
+        // the accumulators all finished the same chunks, so any of them says which are done.
+        for (auto hist : registeredHists) accumulators.at(hist)->LoadChunks(file);
+        if (!registeredHists.empty()) accumulators.at(registeredHists.front())->MarkFinished(chunksDone);
+    }
+    for (auto bootstrap : bootstraps) bootstrap.second->Load(file);
+    file->Close();
+    delete file;
 
+    std::cout << "Resuming from " << checkpointPath << " after " << entriesDone << " events." << std::endl;
+    lastCheckpointEntries = entriesDone;
+    return accumulators.empty() ? nextEntry : entriesDone;
 }
@@ -10,6 +10,55 @@
 #include "TBranchElement.h"
 #include "TLorentzVector.h"
 
+#include "ReproducibleHist.h"
+#include "Bootstrap.h"
+#include "BinLookup.h"
+
+// c++ headers
+#include <array>
+#include <chrono>
+#include <map>
+#include <string>
+#include <vector>
+
+// Bits of the per-event cut mask saved in the cut cache, one per selection stage after "all" in the cutflow.
+enum CutBit { kCut2Photons = 0, kCutFiducial, kCutTriggerPt, kCutExactly2Photons, kCutPtOverMass };
+
+// Indices of the per-event kinematic values in the skim and the cut cache, in the order of HistMaker::eventColumns.
+enum EventColumn { kColPhotonPt1 = 0, kColPhotonPt2, kColPhotonE1, kColPhotonE2, kColPhotonEta1, kColPhotonEta2,
+                   kColPhotonPhi1, kColPhotonPhi2, kColDiphotonMass, kNEventColumns };
+
+// One event of the cut cache: which cuts it passed, its weight, and the kinematics the cuts and histograms need.
+struct CutCacheEntry
+{
+    UInt_t mask = 0;
+    Float_t weight = 0.;
+    std::array<Float_t, kNEventColumns> values; // indexed by EventColumn
+};
+
+// All the events of a cut cache in memory, one array per column, with the settings and totals it was made with.
+struct CutCacheColumns
+{
+    Long64_t nevents = 0;
+    const UInt_t* mask = nullptr;
+    const Float_t* weight = nullptr;
+    std::array<const Float_t*, kNEventColumns> values; // indexed by EventColumn
+    std::map<std::string, float> settings; // by HistMaker::CutSettings name
+    bool isData = false;
+    double sumwAll = 0.; // sum of weights (and squared weights) of all events, including those not in the cache
+    double sumw2All = 0.;
+    Long64_t nAll = 0;
+};
+
+// What FillHist needs to know about one histogram, found once rather than looked up on every fill.
+// Null members mean: fixed-width bins, not in reproducible mode, no bootstrap replicas.
+struct HistFiller
+{
+    const BinLookup* lookup = nullptr;
+    ReproducibleHist1D* accumulator = nullptr;
+    BootstrapHist1D* bootstrap = nullptr;
+};
+
 class HistMaker
 {
 
@@ -21,11 +70,52 @@ public:
 
     float luminosity_ifb = 10.;
 
+    // Selection settings, defaults are the values of the Higgs->GammaGamma analysis.
+    // They can be changed by name with SetCut() before running the EventLooper.
+    float cut_photon_eta_max = 2.37;
+    float cut_photon_eta_crack_low = 1.37;
+    float cut_photon_eta_crack_high = 1.56;
+    float cut_photon_1_pt = 35.; // GeV
+    float cut_photon_2_pt = 25.; // GeV
+    float cut_photon_1_pt_over_m = 0.35;
+    float cut_photon_2_pt_over_m = 0.25;
+
+    // If set, the EventLooper also keeps per-event columns of the selected events in memory (see skimColumns).
+    bool storeSkim = false;
+
+    // Reproducible running: the entries are processed in fixed chunks of chunkSize, each chunk summed with compensated
+    // summation and the chunks merged in chunk order as they finish. The output is then bit-identical whatever nThreads
+    // is. Running on more than one thread always uses this mode.
+    bool reproducible = false;
+    int nThreads = 1;
+    Long64_t chunkSize = 20000;
+
+    // If set, the EventLooper saves the cut mask, weight and kinematics of every event with 2 photons to this file.
+    // RefillFromCache can then redo the selection with changed cuts from the file alone, only re-evaluating the
+    // cuts whose settings changed.
+    std::string cutCachePath = "";
+
+    // Poisson bootstrap: with nBootstrap > 0 every histogram also gets nBootstrap replicas, filled in the same loop with
+    // a Poisson(1) weight per replica for each event, keyed on its (run, event) number. They are written as
+    // <name>_bootstrap TH2Ds (x = the histogram binning, y = replica) for estimating statistical uncertainties.
+    int nBootstrap = 0;
+
+    // Checkpointing: with checkpointPath set, the histograms and how far the event loop got are saved to that file every
+    // checkpointEvents events and/or checkpointSeconds seconds. The file is written to <path>.tmp and renamed, so it is
+    // never left half-written. With resume set the EventLooper carries on from the checkpoint, and the output is the
+    // same as for an uninterrupted run. The checkpoint is removed once the loop finishes.
+    std::string checkpointPath = "";
+    Long64_t checkpointEvents = 0;
+    double checkpointSeconds = 0.;
+    bool resume = false;
+
     // Declaration of leaf types (root types)
     Float_t mcWeight = 0.;
     Float_t xsec_ipb = 0.;
     Float_t sumWeights = 0.;
     Float_t pileupSF = 0.;
+    Int_t runNumber = 0;
+    Int_t eventNumber = 0;
 
     std::vector<Float_t> *photon_pt = 0;
     std::vector<Float_t> *photon_E = 0;
@@ -35,8 +125,33 @@ public:
     // Declare functions
     Long64_t GetNEvents();
     void SetupHist1D(TH1D*& hist, TFile* file, std::string name, int nbins, float xlow, float xhigh, std::string xlab);
+    void SetupHist1D(TH1D*& hist, TFile* file, std::string name, std::vector<double> edges, std::string xlab);
+    void ResetVariableBinStats();
+    bool SetCut(std::string name, float value);
+    std::map<std::string, float*> CutSettings();
+    void BookHists(TFile* outHists);
+    bool PassFiducial(float eta_1, float eta_2);
+    bool PassTriggerPt(float pt_1, float pt_2);
+    bool PassPtOverMass(float pt_1, float pt_2, float mass);
     void Init(TTree *tree);
     void EventLooper(TChain* chain, TFile *outHists, bool isData);
+    void ProcessEntries(Long64_t first, Long64_t last, bool isData);
+    // the MC event weight, also used by the analysis train modules so they all weight the events the same way.
+    static float EventWeight(Float_t weight_mc, Float_t xsec, Float_t sumw, Float_t sf_pileup, float luminosity_ifb);
+    void ProcessEvent(const Float_t* photon_pt, const Float_t* photon_E, const Float_t* photon_eta, const Float_t* photon_phi,
+                      size_t nphotons, float histoweight);
+    void ShareSettings(const HistMaker& other);
+    void StartChunk();
+    void FinishChunk(Long64_t chunk);
+    void FillHist(TH1D* hist, double x, double w);
+    TFile* OpenCutCache(std::string path);
+    void CloseCutCache(TFile* cacheFile, bool isData);
+    void ReadCutCache(std::string path, CutCacheColumns& cache, std::vector<UInt_t>& masks, std::vector<Float_t>& floats);
+    void FillFromCutCache(const CutCacheColumns& cache);
+    void RefillFromCache(std::string path, TFile* outHists);
+    bool CheckpointDue(Long64_t entriesDone);
+    void WriteCheckpoint(Long64_t nextEntry, Long64_t entriesDone, bool isData);
+    Long64_t ReadCheckpoint(std::vector<char>& chunksDone, bool isData);
 
 
     // Define output Histograms
@@ -49,9 +164,61 @@ public:
     TH1D *hist_phiGam_1;
     TH1D *hist_phiGam_2;
     TH1D *hist_mGamGam;
+    TH1D *hist_cutflow;
+
+    // labels of the cutflow bins, in the order the cuts are applied.
+    std::vector<std::string> cutNames = {"all", "2 photons", "fiducial #eta", "photon pT", "exactly 2 photons", "pT/m#gamma#gamma"};
+
+    // All histograms booked via SetupHist1D, in booking order.
+    std::vector<TH1D*> registeredHists;
+    // bin finders of the histograms booked with variable-width bins.
+    std::map<TH1D*, BinLookup> binLookups;
+    // one per registered histogram, indexed by the histogram's unique ID (set by SetupHist1D).
+    std::vector<HistFiller> fillers;
+
+    // variable bin edges of the photon pT histograms, fine where the spectrum is steep and wide in the tail.
+    std::vector<double> photonPtEdges = {0., 25., 30., 35., 40., 45., 50., 55., 60., 70., 80., 90., 100., 120., 140., 170., 200., 250., 300., 400., 500.};
+
+    // names of the per-event kinematic values we keep in the skim and the cut cache, one per EventColumn.
+    std::array<std::string, kNEventColumns> eventColumns = {"photon_pt_1", "photon_pt_2", "photon_E_1", "photon_E_2", "photon_eta_1", "photon_eta_2",
+                                             "photon_phi_1", "photon_phi_2", "diphoton_mass"};
+
+    // Per-event values of the selected events, filled when storeSkim is set.
+    // skimNames gives the column order, each column has one entry per selected event.
+    std::vector<std::string> skimNames;
+    std::map<std::string, std::vector<float>> skimColumns;
+    // true when the histograms are not attached to an output file, so we have to delete them ourselves.
+    bool ownsHists = false;
+    // false for a HistMaker made without a chain, so the destructor leaves the files of the chain it was given alone.
+    bool ownsChainFiles = true;
+
+    // per-histogram chunk accumulators in reproducible mode (empty otherwise), and this HistMaker's sums of the chunk
+    // it is processing, indexed by the histogram's unique ID.
+    std::map<TH1D*, ReproducibleHist1D*> accumulators;
+    std::vector<ChunkSums> chunkSums;
+
+    // the cut cache being written (null if not), the entry we fill it from, and the weights of all events for the cutflow.
+    TTree* cutCache = nullptr;
+    CutCacheEntry cacheEntry;
+    double cacheSumwAll = 0.;
+    double cacheSumw2All = 0.;
+    Long64_t cacheNAll = 0;
+
+    // the bootstrap weights of the current event and the replicas of each histogram, when nBootstrap > 0.
+    BootstrapWeights* bootstrapWeights = nullptr;
+    std::map<TH1D*, BootstrapHist1D*> bootstraps;
+    std::vector<TH2D*> bootstrapHists;
+
+    // how many entries were done, and when, at the last checkpoint.
+    Long64_t lastCheckpointEntries = 0;
+    std::chrono::steady_clock::time_point lastCheckpointTime;
 
     // constructor
     HistMaker(TTree *tree = 0);
+    // a HistMaker without a chain of its own, for events given to it some other way (ProcessEvent, a cut cache) or a
+    // chain passed in later (EventLooper, Init). The chain and its files stay the caller's to delete.
+    struct NoChain {};
+    explicit HistMaker(NoChain);
 
     // destructor
     virtual ~HistMaker();
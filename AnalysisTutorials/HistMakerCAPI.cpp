@@ -0,0 +1,158 @@
+/*
+A plain C interface to the HistMaker, so it can be loaded from python with ctypes (see utils/histmaker.py).
+
+The histogram contents and skim columns are returned as pointers into the buffers owned by the HistMaker,
+so on the python side numpy can wrap them without copying anything. They stay valid until hm_destroy is called.
+
+Build it into a shared library with setup/compile_histmaker_python_lib.sh
+*/
+#include "HistMaker.h"
+
+// Root headers
+#include "TChain.h"
+#include "TH1D.h"
+
+// c++ headers
+#include <exception>
+#include <string>
+#include <vector>
+
+// what we hand to python: the HistMaker plus the chain it reads, and the last error message.
+struct HistMakerHandle
+{
+    HistMaker* maker = nullptr;
+    TChain* chain = nullptr;
+    std::string error;
+};
+
+extern "C" {
+
+HistMakerHandle* hm_create()
+{
+    HistMakerHandle* handle = new HistMakerHandle();
+    // hm_run gives the HistMaker its chain, which the handle owns.
+    handle->maker = new HistMaker(HistMaker::NoChain());
+    return handle;
+}
+
+void hm_destroy(HistMakerHandle* handle)
+{
+    if (!handle) return;
+    delete handle->maker;
+    delete handle->chain;
+    delete handle;
+}
+
+const char* hm_last_error(HistMakerHandle* handle)
+{
+    return handle->error.c_str();
+}
+
+int hm_set_cut(HistMakerHandle* handle, const char* name, float value)
+{
+    if (!handle->maker->SetCut(name, value))
+    {
+        handle->error = std::string("no cut called ") + name;
+        return 1;
+    }
+    return 0;
+}
+
+void hm_set_threads(HistMakerHandle* handle, int nThreads, int reproducible)
+{
+    handle->maker->nThreads = nThreads;
+    handle->maker->reproducible = reproducible;
+}
+
+int hm_run(HistMakerHandle* handle, const char* treename, const char** files, int nfiles, int isData, int storeSkim)
+{
+    // build the chain from the list of files and run the event loop, keeping the histograms in memory.
+    try
+    {
+        // in case of an earlier run on this handle.
+        handle->maker->fChain = nullptr;
+        delete handle->chain;
+        handle->chain = new TChain(treename, "");
+        for (int i=0; i<nfiles; i++)
+        {
+            // with nentries = 0 the file is opened now, so a missing or unreadable file is caught here, not in the event loop.
+            if (handle->chain->Add(files[i], 0) == 0)
+            {
+                handle->error = std::string("couldn't read the ") + treename + " tree from " + files[i];
+                return 1;
+            }
+        }
+        if (handle->chain->GetEntries() <= 0)
+        {
+            handle->error = "there are no events in the input files";
+            return 1;
+        }
+        handle->maker->storeSkim = storeSkim;
+        handle->maker->EventLooper(handle->chain, nullptr, isData);
+    }
+    catch (const std::exception& e)
+    {
+        handle->error = e.what();
+        return 1;
+    }
+    return 0;
+}
+
+int hm_n_hists(HistMakerHandle* handle)
+{
+    return handle->maker->registeredHists.size();
+}
+
+const char* hm_hist_name(HistMakerHandle* handle, int i)
+{
+    return handle->maker->registeredHists.at(i)->GetName();
+}
+
+int hm_hist_nbins(HistMakerHandle* handle, int i)
+{
+    return handle->maker->registeredHists.at(i)->GetNbinsX();
+}
+
+void hm_hist_edges(HistMakerHandle* handle, int i, double* edges)
+{
+    // fill the caller's buffer (nbins+1 long) with the bin edges.
+    TH1D* hist = handle->maker->registeredHists.at(i);
+    int nbins = hist->GetNbinsX();
+    for (int bin=1; bin<=nbins; bin++) edges[bin-1] = hist->GetXaxis()->GetBinLowEdge(bin);
+    edges[nbins] = hist->GetXaxis()->GetBinUpEdge(nbins);
+}
+
+const double* hm_hist_contents(HistMakerHandle* handle, int i)
+{
+    // nbins+2 values: underflow, the bins, overflow.
+    return handle->maker->registeredHists.at(i)->GetArray();
+}
+
+const double* hm_hist_sumw2(HistMakerHandle* handle, int i)
+{
+    // nbins+2 values laid out like the contents.
+    return handle->maker->registeredHists.at(i)->GetSumw2()->GetArray();
+}
+
+long hm_skim_size(HistMakerHandle* handle)
+{
+    if (handle->maker->skimNames.empty()) return 0;
+    return handle->maker->skimColumns[handle->maker->skimNames[0]].size();
+}
+
+int hm_n_skim_columns(HistMakerHandle* handle)
+{
+    return handle->maker->skimNames.size();
+}
+
+const char* hm_skim_name(HistMakerHandle* handle, int i)
+{
+    return handle->maker->skimNames.at(i).c_str();
+}
+
+const float* hm_skim_column(HistMakerHandle* handle, int i)
+{
+    return handle->maker->skimColumns[handle->maker->skimNames.at(i)].data();
+}
+
+}
@@ -0,0 +1,84 @@
+#define HistServerClient_cpp
+#include "HistServerClient.h"
+
+// c++ headers
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+HistServerClient::HistServerClient(std::string socketPath)
+{
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+    if (fd < 0 || connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0)
+    {
+        throw std::runtime_error("couldn't connect to the histogram server at "+socketPath+", is it running?");
+    }
+}
+
+HistServerClient::~HistServerClient()
+{
+    close(fd);
+}
+
+std::vector<std::string> HistServerClient::Request(std::string request)
+{
+    // send one request line and return the words of the reply after the "OK".
+    request += "\n";
+    if (write(fd, request.c_str(), request.size()) != (ssize_t)request.size()) throw std::runtime_error("lost the connection to the histogram server");
+
+    size_t end;
+    while ((end = buffer.find('\n')) == std::string::npos)
+    {
+        char chunk[4096];
+        ssize_t n = read(fd, chunk, sizeof(chunk));
+        if (n <= 0) throw std::runtime_error("lost the connection to the histogram server");
+        buffer.append(chunk, n);
+    }
+    std::string reply = buffer.substr(0, end);
+    buffer.erase(0, end + 1);
+
+    std::stringstream ss(reply);
+    std::string status, word;
+    ss >> status;
+    if (status != "OK") throw std::runtime_error("histogram server: "+reply);
+    std::vector<std::string> words;
+    while (ss >> word) words.push_back(word);
+    return words;
+}
+
+TH1F* HistServerClient::GetHist(std::string sample, std::string histname, std::map<std::string, float> cuts)
+{
+    // fetch a histogram for a sample, with any changed cut settings, and copy it out of shared memory into a TH1F.
+    std::string request = "HIST " + sample + " " + histname;
+    for (auto cut : cuts) request += " " + cut.first + "=" + std::to_string(cut.second);
+    std::vector<std::string> reply = Request(request);
+    std::string shmName = reply.at(0);
+    size_t nvalues = std::stoul(reply.at(1));
+    int nbins = std::stoi(reply.at(2));
+
+    int shmFd = shm_open(shmName.c_str(), O_RDONLY, 0);
+    if (shmFd < 0) throw std::runtime_error("couldn't open the shared memory "+shmName);
+    void* mem = mmap(nullptr, nvalues*sizeof(double), PROT_READ, MAP_SHARED, shmFd, 0);
+    close(shmFd);
+    if (mem == MAP_FAILED) throw std::runtime_error("couldn't map the shared memory "+shmName);
+    const double* values = (const double*)mem;
+
+    TH1F* hist = new TH1F((sample+"_"+histname).c_str(), (histname+";;Events / bin").c_str(), nbins, values + (nbins+2)*2);
+    hist->SetDirectory(nullptr);
+    hist->Sumw2();
+    for (int bin=0; bin<nbins+2; bin++)
+    {
+        hist->SetBinContent(bin, values[bin]);
+        hist->GetSumw2()->SetAt(values[nbins+2+bin], bin);
+    }
+    munmap(mem, nvalues*sizeof(double));
+    return hist;
+}
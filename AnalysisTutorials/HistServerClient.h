@@ -0,0 +1,42 @@
+#ifndef HistServerClient_h
+#define HistServerClient_h
+
+// Root headers
+#include "TH1F.h"
+
+// c++ headers
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+Client for the local histogram server (hist_server_root.cpp).
+
+The protocol is one line of text per request over a Unix socket, answered by one line:
+    SAMPLES                              -> OK <n> <sample> ...
+    COLUMNS <sample>                     -> OK <shm name> <nevents> <column> ...
+    HIST <sample> <hist> [<cut>=<value>] -> OK <shm name> <nvalues> <nbins>
+    SHUTDOWN                             -> OK
+or "ERR <message>". The values themselves don't go through the socket, they are left in the POSIX shared memory
+segment named in the reply: for HIST the nbins+2 bin contents (including under/overflow), the nbins+2 sums of
+weights squared and the nbins+1 bin edges, as doubles. <hist> is any histogram the HistMaker books, including the cutflow.
+*/
+
+const std::string kHistServerSocket = "/tmp/cmpp_hist_server.sock";
+
+class HistServerClient
+{
+
+public:
+    HistServerClient(std::string socketPath = kHistServerSocket);
+    virtual ~HistServerClient();
+
+    std::vector<std::string> Request(std::string request);
+    TH1F* GetHist(std::string sample, std::string histname, std::map<std::string, float> cuts = {});
+
+private:
+    int fd;
+    std::string buffer; // anything read past the end of the last reply
+};
+
+#endif /* HistServerClient_h */
@@ -0,0 +1,163 @@
+#define ReproducibleHist_cpp
+#include "ReproducibleHist.h"
+
+// c++ headers
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+void CompensatedSum::Add(double x)
+{
+    double t = sum + x;
+    // the rounding error is whatever of the smaller term didn't make it into t.
+    if (std::fabs(sum) >= std::fabs(x)) comp += (sum - t) + x;
+    else comp += (x - t) + sum;
+    sum = t;
+}
+
+void CompensatedSum::Add(const CompensatedSum& other)
+{
+    Add(other.sum);
+    Add(other.comp);
+}
+
+void ChunkSums::Reset(int ncells)
+{
+    sumw.assign(ncells, CompensatedSum());
+    sumw2.assign(ncells, CompensatedSum());
+    nfills = 0;
+}
+
+void ChunkSums::Fill(int bin, double w)
+{
+    sumw[bin].Add(w);
+    sumw2[bin].Add(w*w);
+    nfills++;
+}
+
+ReproducibleHist1D::ReproducibleHist1D(TH1D* hist, Long64_t nchunks) : hist(hist), nchunks(nchunks)
+{
+    ncells = hist->GetNbinsX() + 2;
+    merged.Reset(ncells);
+}
+
+void ReproducibleHist1D::Merge(const ChunkSums& sums)
+{
+    for (int bin=0; bin<ncells; bin++)
+    {
+        merged.sumw[bin].Add(sums.sumw[bin]);
+        merged.sumw2[bin].Add(sums.sumw2[bin]);
+    }
+    merged.nfills += sums.nfills;
+}
+
+void ReproducibleHist1D::FinishChunk(Long64_t chunk, const ChunkSums& sums)
+{
+    // always adding to the total in chunk order gives the same rounding whichever order the chunks finish in.
+    if (chunk != nextChunk)
+    {
+        pending[chunk] = sums;
+        return;
+    }
+    Merge(sums);
+    nextChunk++;
+    // the chunks that were waiting for this one.
+    while (!pending.empty() && pending.begin()->first == nextChunk)
+    {
+        Merge(pending.begin()->second);
+        pending.erase(pending.begin());
+        nextChunk++;
+    }
+}
+
+void ReproducibleHist1D::MarkFinished(std::vector<char>& chunksDone) const
+{
+    for (Long64_t chunk=0; chunk<nextChunk; chunk++) chunksDone[chunk] = 1;
+    for (auto& chunk : pending) chunksDone[chunk.first] = 1;
+}
+
+void ReproducibleHist1D::WriteToHist()
+{
+    // overwrite the histogram contents with the merged totals.
+    if (nextChunk != nchunks) throw std::runtime_error(std::string("not all the chunks of ") + hist->GetName() + " were filled");
+    for (int bin=0; bin<ncells; bin++)
+    {
+        hist->SetBinContent(bin, merged.sumw[bin].Value());
+        hist->GetSumw2()->SetAt(merged.sumw2[bin].Value(), bin);
+    }
+    // recompute mean/rms from the bins rather than per fill, so they are reproducible too.
+    hist->ResetStats();
+    hist->SetEntries(merged.nfills);
+}
+
+namespace
+{
+    // a ChunkSums as 4*ncells+1 doubles: sum and compensation of sumw and sumw2 for each bin, then the number of fills.
+    void AppendSums(std::vector<double>& saved, const ChunkSums& sums)
+    {
+        for (size_t bin=0; bin<sums.sumw.size(); bin++)
+        {
+            saved.push_back(sums.sumw[bin].sum);
+            saved.push_back(sums.sumw[bin].comp);
+            saved.push_back(sums.sumw2[bin].sum);
+            saved.push_back(sums.sumw2[bin].comp);
+        }
+        saved.push_back(sums.nfills);
+    }
+
+    const double* ReadSums(const double* block, int ncells, ChunkSums& sums)
+    {
+        sums.Reset(ncells);
+        for (int bin=0; bin<ncells; bin++)
+        {
+            sums.sumw[bin].sum = block[4*bin];
+            sums.sumw[bin].comp = block[4*bin + 1];
+            sums.sumw2[bin].sum = block[4*bin + 2];
+            sums.sumw2[bin].comp = block[4*bin + 3];
+        }
+        sums.nfills = block[4*ncells];
+        return block + 4*ncells + 1;
+    }
+}
+
+void ReproducibleHist1D::SaveChunks(TDirectory* dir)
+{
+    // write the merged total and the chunks waiting to be merged for a checkpoint, as <hist>_chunks:
+    // the next chunk to merge, the number waiting, the total, then the chunk number and sums of each waiting chunk.
+    std::vector<double> saved = {double(nextChunk), double(pending.size())};
+    AppendSums(saved, merged);
+    for (auto& chunk : pending)
+    {
+        saved.push_back(chunk.first);
+        AppendSums(saved, chunk.second);
+    }
+    dir->WriteObject(&saved, (std::string(hist->GetName()) + "_chunks").c_str());
+}
+
+void ReproducibleHist1D::LoadChunks(TDirectory* dir)
+{
+    // restore the state written by SaveChunks.
+    std::vector<double>* saved = dir->Get<std::vector<double>>((std::string(hist->GetName()) + "_chunks").c_str());
+    size_t blockSize = 4*ncells + 1;
+    bool ok = saved && saved->size() >= 2 + blockSize && saved->size() == 2 + blockSize + size_t((*saved)[1])*(1 + blockSize);
+    if (!ok || (*saved)[0] > nchunks)
+    {
+        delete saved;
+        throw std::runtime_error(std::string("checkpoint doesn't match the chunks of ") + hist->GetName());
+    }
+    nextChunk = (*saved)[0];
+    size_t npending = (*saved)[1];
+    const double* block = ReadSums(saved->data() + 2, ncells, merged);
+    pending.clear();
+    for (size_t ipending=0; ipending<npending; ipending++)
+    {
+        Long64_t chunk = block[0];
+        if (chunk <= nextChunk || chunk >= nchunks)
+        {
+            delete saved;
+            throw std::runtime_error(std::string("checkpoint doesn't match the chunks of ") + hist->GetName());
+        }
+        block = ReadSums(block + 1, ncells, pending[chunk]);
+    }
+    delete saved;
+}
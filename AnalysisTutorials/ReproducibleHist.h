@@ -0,0 +1,66 @@
+#ifndef ReproducibleHist_h
+#define ReproducibleHist_h
+
+// Root headers
+#include "TH1D.h"
+#include "TDirectory.h"
+
+// c++ headers
+#include <map>
+#include <vector>
+
+// Neumaier compensated sum: keeps track of the rounding error of each addition, so a long sum of
+// weights with a wide dynamic range doesn't lose the small ones.
+struct CompensatedSum
+{
+    double sum = 0.;
+    double comp = 0.;
+
+    void Add(double x);
+    void Add(const CompensatedSum& other);
+    double Value() const { return sum + comp; }
+};
+
+// The sums of one histogram over one chunk of events, filled by the thread processing the chunk.
+struct ChunkSums
+{
+    std::vector<CompensatedSum> sumw; // per bin, including underflow and overflow
+    std::vector<CompensatedSum> sumw2;
+    Long64_t nfills = 0;
+
+    void Reset(int ncells);
+    void Fill(int bin, double w);
+};
+
+// Accumulates the fills of a TH1D in fixed chunks of events, and writes them into the histogram at the end. The chunks
+// are merged in chunk order into a running total as they finish: a chunk that finishes before the ones ahead of it is
+// kept until they are done, so only the chunks still being processed by other threads are held at any time.
+// As the chunking doesn't depend on the number of threads, neither does the result.
+class ReproducibleHist1D
+{
+
+public:
+    ReproducibleHist1D(TH1D* hist, Long64_t nchunks);
+
+    int NCells() const { return ncells; }
+    // add the sums of a finished chunk, each chunk once. Not thread safe, the caller has to serialise the calls.
+    void FinishChunk(Long64_t chunk, const ChunkSums& sums);
+    // mark the chunks added so far in chunksDone.
+    void MarkFinished(std::vector<char>& chunksDone) const;
+    void WriteToHist();
+    void SaveChunks(TDirectory* dir);
+    void LoadChunks(TDirectory* dir);
+
+    TH1D* hist;
+
+private:
+    void Merge(const ChunkSums& sums);
+
+    int ncells; // bins including underflow and overflow
+    Long64_t nchunks;
+    Long64_t nextChunk = 0; // the chunks before this are merged into merged
+    ChunkSums merged;
+    std::map<Long64_t, ChunkSums> pending; // finished, but waiting for an earlier chunk
+};
+
+#endif /* ReproducibleHist_h */
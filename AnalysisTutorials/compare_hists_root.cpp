@@ -0,0 +1,134 @@
+// Root headers
+#include "TROOT.h"
+#include "TFile.h"
+#include "TClass.h"
+#include "TH1D.h"
+#include "TKey.h"
+#include "TList.h"
+
+// c++ headers
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+/*
+Compare the histograms in two output files bin by bin, e.g. to check a run on N threads in --reproducible mode gives
+exactly the same histograms as a run on 1 thread.
+
+Usage:
+    ./compare_hists_root file1.root file2.root [relative tolerance]
+
+With no tolerance the bin edges, bin contents and errors (including under- and overflow) and the number of entries
+have to be bit-identical. Exits with 1 if any histogram differs or is only in one of the files.
+*/
+
+bool sameValue(double a, double b, double tolerance)
+{
+    // exact comparison of the bits if no tolerance is given, so we also notice differences in the last digit.
+    if (tolerance == 0.) return std::memcmp(&a, &b, sizeof(double)) == 0;
+    return std::fabs(a - b) <= tolerance*std::max(std::fabs(a), std::fabs(b));
+}
+
+bool sameAxis(std::string name, const TAxis* axis1, const TAxis* axis2, double tolerance)
+{
+    // same number of bins isn't enough, the edges have to match too.
+    if (axis1->GetNbins() != axis2->GetNbins())
+    {
+        std::cout << name << ": different number of " << axis1->GetName() << " bins, " << axis1->GetNbins() << " vs " << axis2->GetNbins() << std::endl;
+        return false;
+    }
+    for (int bin=1; bin<=axis1->GetNbins()+1; bin++)
+    {
+        if (!sameValue(axis1->GetBinLowEdge(bin), axis2->GetBinLowEdge(bin), tolerance))
+        {
+            std::cout.precision(17);
+            std::cout << name << ": different " << axis1->GetName() << " edge " << bin-1 << ", " << axis1->GetBinLowEdge(bin) << " vs " << axis2->GetBinLowEdge(bin) << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int compareHists(TH1* hist1, TH1* hist2, double tolerance)
+{
+    // returns the number of differences, printing each of them.
+    std::string name = hist1->GetName();
+    if (hist1->GetDimension() != hist2->GetDimension() || hist1->GetNcells() != hist2->GetNcells())
+    {
+        std::cout << name << ": different number of bins, " << hist1->GetNcells() << " vs " << hist2->GetNcells() << std::endl;
+        return hist1->GetNcells();
+    }
+    if (!sameAxis(name, hist1->GetXaxis(), hist2->GetXaxis(), tolerance)) return 1;
+    if (hist1->GetDimension() > 1 && !sameAxis(name, hist1->GetYaxis(), hist2->GetYaxis(), tolerance)) return 1;
+    if (hist1->GetDimension() > 2 && !sameAxis(name, hist1->GetZaxis(), hist2->GetZaxis(), tolerance)) return 1;
+
+    int ndiff = 0;
+    if (!sameValue(hist1->GetEntries(), hist2->GetEntries(), tolerance))
+    {
+        std::cout.precision(17);
+        std::cout << name << ": " << hist1->GetEntries() << " vs " << hist2->GetEntries() << " entries" << std::endl;
+        ndiff++;
+    }
+    for (int bin=0; bin<hist1->GetNcells(); bin++)
+    {
+        double content1 = hist1->GetBinContent(bin);
+        double content2 = hist2->GetBinContent(bin);
+        double error1 = hist1->GetBinError(bin);
+        double error2 = hist2->GetBinError(bin);
+        if (!sameValue(content1, content2, tolerance) || !sameValue(error1, error2, tolerance))
+        {
+            std::cout.precision(17);
+            std::cout << name << " bin " << bin << ": " << content1 << " +- " << error1 << " vs " << content2 << " +- " << error2 << std::endl;
+            ndiff++;
+        }
+    }
+    return ndiff;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3) throw std::runtime_error("need 2 files to compare (and optionally a relative tolerance)");
+    double tolerance = (argc > 3) ? std::stod(argv[3]) : 0.;
+
+    TFile* file1 = TFile::Open(argv[1], "READ");
+    TFile* file2 = TFile::Open(argv[2], "READ");
+    if (!file1 || file1->IsZombie() || !file2 || file2->IsZombie()) throw std::runtime_error("couldn't open the input files");
+
+    int nhists = 0;
+    int nbad = 0;
+    TIter next(file1->GetListOfKeys());
+    while (TKey* key = (TKey*)next())
+    {
+        TObject* obj = key->ReadObj();
+        if (!obj->InheritsFrom("TH1")) continue;
+        TH1* hist1 = (TH1*)obj;
+        TH1* hist2 = (TH1*)file2->Get(hist1->GetName());
+        nhists++;
+        if (!hist2)
+        {
+            std::cout << hist1->GetName() << ": missing from " << argv[2] << std::endl;
+            nbad++;
+            continue;
+        }
+        if (compareHists(hist1, hist2, tolerance) > 0) nbad++;
+    }
+
+    // and anything only in the second file.
+    TIter next2(file2->GetListOfKeys());
+    while (TKey* key = (TKey*)next2())
+    {
+        TClass* keyClass = TClass::GetClass(key->GetClassName());
+        if (!keyClass || !keyClass->InheritsFrom("TH1")) continue;
+        if (file1->GetKey(key->GetName())) continue;
+        std::cout << key->GetName() << ": missing from " << argv[1] << std::endl;
+        nhists++;
+        nbad++;
+    }
+
+    std::cout << nhists << " histograms compared, " << nbad << " differ." << std::endl;
+    file1->Close();
+    file2->Close();
+    return (nbad > 0) ? 1 : 0;
+}
@@ -0,0 +1,384 @@
+#include "HistMaker.h"
+#include "HistServerClient.h"
+
+// Root headers
+#include "TROOT.h"
+#include "TH1D.h"
+
+// c++ headers
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+A long-running local server that keeps the selected-event columns of the GamGam samples in shared memory, so the
+plotter and the notebooks can ask for histograms without anyone reopening the ntuples or the histogram files.
+
+It reads the cut caches written by part1_process_TTree_root --cut-cache (one per sample) at startup:
+    ./hist_server_root ggfHiggs=histograms/GamGam_rootCpp/ggfHiggs_cuts.root data=histograms/GamGam_rootCpp/data_cuts.root
+and then answers requests on a Unix socket (default /tmp/cmpp_hist_server.sock, or --socket PATH), see
+HistServerClient.h for the protocol. A histogram request with a set of cuts not seen before redoes the selection from
+the resident columns (milliseconds for the GamGam samples), the booked histograms are then kept for repeated requests.
+The results go back through a shared memory segment per connection, only the reply line goes over the socket.
+
+Stop it with ctrl-c or a SHUTDOWN request, it cleans up its shared memory and socket on the way out.
+*/
+
+volatile std::sig_atomic_t stopRequested = 0;
+void handleStop(int) { stopRequested = 1; }
+
+// A POSIX shared memory segment we created, mapped read-write.
+struct SharedSegment
+{
+    std::string name;
+    void* mem = nullptr;
+    size_t size = 0;
+
+    void Resize(size_t newSize)
+    {
+        // (re)create the segment big enough for newSize bytes, keeping the same name.
+        if (newSize <= size && mem) return;
+        if (mem) munmap(mem, size);
+        int shmFd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0600);
+        if (shmFd < 0 || ftruncate(shmFd, newSize) != 0) throw std::runtime_error("couldn't create the shared memory "+name);
+        mem = mmap(nullptr, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, shmFd, 0);
+        close(shmFd);
+        if (mem == MAP_FAILED) throw std::runtime_error("couldn't map the shared memory "+name);
+        size = newSize;
+    }
+
+    void Remove()
+    {
+        if (mem) munmap(mem, size);
+        shm_unlink(name.c_str());
+        mem = nullptr;
+    }
+};
+
+// One sample's cut cache, with the columns living in shared memory.
+struct ResidentSample
+{
+    SharedSegment segment;
+    CutCacheColumns columns;
+};
+
+// The booked histograms of one sample for one set of cuts.
+struct BookedResult
+{
+    std::string key;
+    HistMaker* maker;
+};
+
+class HistServer
+{
+
+public:
+    void LoadSample(std::string sample, std::string cachePath);
+    std::string Handle(std::string request, SharedSegment& result);
+    void Cleanup();
+
+    std::map<std::string, ResidentSample> samples;
+    std::vector<std::string> eventColumns; // names of the float columns after the weight
+    bool shutdown = false;
+
+private:
+    HistMaker* GetBooked(std::string sample, std::map<std::string, float> cuts);
+    std::deque<BookedResult> booked; // most recent at the back
+    size_t maxBooked = 64;
+};
+
+void HistServer::LoadSample(std::string sample, std::string cachePath)
+{
+    // read the cut cache and move its columns into a shared memory segment the clients can also map.
+    HistMaker reader{HistMaker::NoChain()};
+    eventColumns.assign(reader.eventColumns.begin(), reader.eventColumns.end());
+    std::vector<UInt_t> masks;
+    std::vector<Float_t> floats;
+    ResidentSample& resident = samples[sample];
+    reader.ReadCutCache(cachePath, resident.columns, masks, floats);
+
+    // layout: weight, then the event columns, then the masks, all 4 bytes per value.
+    Long64_t nevents = resident.columns.nevents;
+    resident.segment.name = "/cmpp_cols_" + sample;
+    resident.segment.Resize(std::max<size_t>(1, (floats.size() + masks.size())*4));
+    Float_t* floatMem = (Float_t*)resident.segment.mem;
+    UInt_t* maskMem = (UInt_t*)(floatMem + floats.size());
+    std::memcpy(floatMem, floats.data(), floats.size()*sizeof(Float_t));
+    std::memcpy(maskMem, masks.data(), masks.size()*sizeof(UInt_t));
+
+    resident.columns.weight = floatMem;
+    for (size_t i=0; i<resident.columns.values.size(); i++) resident.columns.values[i] = floatMem + (i+1)*nevents;
+    resident.columns.mask = maskMem;
+    std::cout << "Loaded " << nevents << " events of " << sample << " into " << resident.segment.name << std::endl;
+}
+
+HistMaker* HistServer::GetBooked(std::string sample, std::map<std::string, float> cuts)
+{
+    // the histograms for this sample and cuts, filling them from the resident columns if we don't have them yet.
+    // 9 significant digits tell any two floats apart, std::to_string's 6 decimals would merge nearby cut values.
+    std::ostringstream keyStream;
+    keyStream << sample << std::setprecision(9);
+    for (auto cut : cuts) keyStream << " " << cut.first << "=" << cut.second;
+    std::string key = keyStream.str();
+    for (auto it = booked.begin(); it != booked.end(); it++)
+    {
+        if (it->key != key) continue;
+        BookedResult found = *it;
+        booked.erase(it);
+        booked.push_back(found);
+        return found.maker;
+    }
+
+    // start from the settings the cache was made with, so only the requested cuts differ.
+    BookedResult result;
+    result.key = key;
+    result.maker = new HistMaker(HistMaker::NoChain());
+    const CutCacheColumns& columns = samples.at(sample).columns;
+    for (auto setting : columns.settings) result.maker->SetCut(setting.first, setting.second);
+    for (auto cut : cuts)
+    {
+        if (!result.maker->SetCut(cut.first, cut.second)) throw std::runtime_error("no cut called "+cut.first);
+    }
+    result.maker->BookHists(nullptr);
+    result.maker->FillFromCutCache(columns);
+
+    booked.push_back(result);
+    if (booked.size() > maxBooked)
+    {
+        delete booked.front().maker;
+        booked.pop_front();
+    }
+    return result.maker;
+}
+
+std::string HistServer::Handle(std::string request, SharedSegment& result)
+{
+    // answer one request line, leaving any values in the connection's result segment.
+    std::stringstream ss(request);
+    std::string command;
+    ss >> command;
+    std::stringstream reply;
+    reply << "OK";
+
+    if (command == "SAMPLES")
+    {
+        reply << " " << samples.size();
+        for (auto& sample : samples) reply << " " << sample.first;
+    }
+    else if (command == "COLUMNS")
+    {
+        std::string sample;
+        ss >> sample;
+        if (samples.find(sample) == samples.end()) return "ERR unknown sample " + sample;
+        ResidentSample& resident = samples[sample];
+        reply << " " << resident.segment.name << " " << resident.columns.nevents << " weight";
+        for (auto name : eventColumns) reply << " " << name;
+        reply << " mask";
+    }
+    else if (command == "HIST")
+    {
+        std::string sample, histname, cut;
+        ss >> sample >> histname;
+        if (samples.find(sample) == samples.end()) return "ERR unknown sample " + sample;
+        std::map<std::string, float> cuts;
+        while (ss >> cut)
+        {
+            size_t split = cut.find('=');
+            if (split == std::string::npos) return "ERR cuts should be name=value, not " + cut;
+            cuts[cut.substr(0, split)] = std::stof(cut.substr(split+1));
+        }
+
+        HistMaker* maker = GetBooked(sample, cuts);
+        TH1D* hist = nullptr;
+        for (auto registered : maker->registeredHists)
+        {
+            if (histname == registered->GetName()) hist = registered;
+        }
+        if (!hist) return "ERR no histogram called " + histname;
+
+        int nbins = hist->GetNbinsX();
+        size_t nvalues = (nbins+2)*2 + nbins+1;
+        result.Resize(nvalues*sizeof(double));
+        double* values = (double*)result.mem;
+        std::memcpy(values, hist->GetArray(), (nbins+2)*sizeof(double));
+        std::memcpy(values + nbins+2, hist->GetSumw2()->GetArray(), (nbins+2)*sizeof(double));
+        // the bin edges too, so variable-width bins come through the same way as uniform ones.
+        double* edges = values + (nbins+2)*2;
+        for (int bin=1; bin<=nbins; bin++) edges[bin-1] = hist->GetXaxis()->GetBinLowEdge(bin);
+        edges[nbins] = hist->GetXaxis()->GetBinUpEdge(nbins);
+        reply << " " << result.name << " " << nvalues << " " << nbins;
+    }
+    else if (command == "SHUTDOWN")
+    {
+        shutdown = true;
+    }
+    else
+    {
+        return "ERR unknown request " + command;
+    }
+    return reply.str();
+}
+
+void HistServer::Cleanup()
+{
+    for (auto& sample : samples) sample.second.segment.Remove();
+    for (auto& result : booked) delete result.maker;
+    booked.clear();
+}
+
+int main(int argc, char* argv[])
+{
+    std::string socketPath = kHistServerSocket;
+    HistServer server;
+    for (int iarg=1; iarg<argc; iarg++)
+    {
+        std::string arg = argv[iarg];
+        size_t split = arg.find('=');
+        if (arg == "--socket" && iarg+1 < argc) socketPath = argv[++iarg];
+        else if (split != std::string::npos) server.LoadSample(arg.substr(0, split), arg.substr(split+1));
+        else throw std::runtime_error("arguments should be sample=cutcache.root or --socket PATH, not "+arg);
+    }
+    if (server.samples.empty()) throw std::runtime_error("need at least one sample=cutcache.root to serve");
+
+    std::signal(SIGINT, handleStop);
+    std::signal(SIGTERM, handleStop);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    int listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+    unlink(socketPath.c_str());
+    if (listenFd < 0 || bind(listenFd, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listenFd, 16) != 0)
+    {
+        throw std::runtime_error("couldn't listen on "+socketPath);
+    }
+    std::cout << "Serving histograms on " << socketPath << std::endl;
+
+    // each connection has its own partial request buffer, reply not yet sent and result segment.
+    struct Connection
+    {
+        int fd;
+        std::string buffer;
+        std::string unsent;
+        SharedSegment result;
+    };
+    std::vector<Connection> connections;
+    int nconnections = 0;
+
+    // the client sockets are non-blocking, so a client slow to read its replies can't hold up the others:
+    // write what the socket takes now and keep the rest for when poll says it has room.
+    auto sendReply = [](Connection& connection)
+    {
+        while (!connection.unsent.empty())
+        {
+            ssize_t n = write(connection.fd, connection.unsent.data(), connection.unsent.size());
+            if (n > 0) connection.unsent.erase(0, n);
+            else if (n < 0 && errno == EINTR) continue;
+            else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+            else
+            {
+                close(connection.fd);
+                connection.fd = -1;
+                return;
+            }
+        }
+    };
+
+    while (!stopRequested && !server.shutdown)
+    {
+        std::vector<pollfd> fds = {{listenFd, POLLIN, 0}};
+        // a connection with a reply still to send isn't read from until it's sent, so we never queue more than one.
+        for (auto& connection : connections) fds.push_back({connection.fd, short(connection.unsent.empty() ? POLLIN : POLLOUT), 0});
+        // time out now and then to notice a ctrl-c
+        if (poll(fds.data(), fds.size(), 500) <= 0) continue;
+
+        if (fds[0].revents & POLLIN)
+        {
+            int fd = accept(listenFd, nullptr, nullptr);
+            if (fd >= 0)
+            {
+                fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+                Connection connection;
+                connection.fd = fd;
+                connection.result.name = "/cmpp_result_" + std::to_string(getpid()) + "_" + std::to_string(nconnections++);
+                connections.push_back(connection);
+            }
+        }
+
+        for (size_t i=1; i<fds.size(); i++)
+        {
+            Connection& connection = connections[i-1];
+            if (fds[i].revents & POLLOUT) sendReply(connection);
+            if (connection.fd >= 0 && (fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+            {
+                char chunk[4096];
+                ssize_t n = read(connection.fd, chunk, sizeof(chunk));
+                if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR))
+                {
+                    close(connection.fd);
+                    connection.fd = -1;
+                    continue;
+                }
+                if (n > 0) connection.buffer.append(chunk, n);
+            }
+            // answer the complete requests one at a time, the next once the last reply is sent.
+            size_t end;
+            while (connection.fd >= 0 && connection.unsent.empty() && (end = connection.buffer.find('\n')) != std::string::npos)
+            {
+                std::string request = connection.buffer.substr(0, end);
+                connection.buffer.erase(0, end + 1);
+                auto start = std::chrono::steady_clock::now();
+                std::string reply;
+                try
+                {
+                    reply = server.Handle(request, connection.result);
+                }
+                catch (const std::exception& e)
+                {
+                    reply = std::string("ERR ") + e.what();
+                }
+                double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+                std::cout << request << " -> " << reply.substr(0, 2) << " (" << ms << " ms)" << std::endl;
+                connection.unsent = reply + "\n";
+                sendReply(connection);
+            }
+        }
+
+        // forget closed connections and their result segments
+        for (auto it = connections.begin(); it != connections.end();)
+        {
+            if (it->fd < 0)
+            {
+                it->result.Remove();
+                it = connections.erase(it);
+            }
+            else it++;
+        }
+    }
+
+    std::cout << "Shutting down the histogram server." << std::endl;
+    for (auto& connection : connections)
+    {
+        // e.g. the reply to the shutdown request, if the socket takes it.
+        if (connection.fd >= 0) sendReply(connection);
+        if (connection.fd >= 0) close(connection.fd);
+        connection.result.Remove();
+    }
+    close(listenFd);
+    unlink(socketPath.c_str());
+    server.Cleanup();
+    return 0;
+}
@@ -0,0 +1,55 @@
+// c++ headers
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+/*
+Launcher for builds with CMPP_ISA_VARIANTS set (see CMakeLists.txt).
+
+There is a copy of the real executable per instruction set, e.g. part1_process_TTree_root_avx512, _avx2 and _generic,
+next to this one. We check what the CPU we're running on supports and replace ourselves with the fastest copy that
+was built, passing the command line arguments straight through.
+Setting CMPP_ISA=generic (or avx2, avx512) in the environment forces a particular copy.
+*/
+
+bool isExecutable(const std::string& path)
+{
+    return access(path.c_str(), X_OK) == 0;
+}
+
+int main(int argc, char* argv[])
+{
+    // the variants live in the same directory as this launcher.
+    char self[4096];
+    ssize_t len = readlink("/proc/self/exe", self, sizeof(self) - 1);
+    if (len < 0)
+    {
+        std::perror("couldn't find the launcher path");
+        return EXIT_FAILURE;
+    }
+    self[len] = '\0';
+    std::string dir = self;
+    dir = dir.substr(0, dir.rfind('/') + 1);
+    std::string base = dir + CMPP_DISPATCH_TARGET + "_";
+
+    std::string variant = "generic";
+    const char* forced = std::getenv("CMPP_ISA");
+    if (forced)
+    {
+        variant = forced;
+    }
+    else
+    {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") && isExecutable(base + "avx512")) variant = "avx512";
+        else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") && isExecutable(base + "avx2")) variant = "avx2";
+    }
+
+    std::string target = base + variant;
+    argv[0] = const_cast<char*>(target.c_str());
+    execv(target.c_str(), argv);
+    // execv only comes back if it failed.
+    std::perror(("couldn't run " + target).c_str());
+    return EXIT_FAILURE;
+}
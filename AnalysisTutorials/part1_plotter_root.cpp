@@ -38,6 +38,7 @@ Things to try:
 #include "Fit/DataRange.h"
 
 #include "../utils/AtlasStyle.C"
+#include "HistServerClient.h"
 
 // c++ headers
 #include <iostream>
@@ -45,7 +46,7 @@ Things to try:
 #include <stdexcept>
 #include <string>
 
-void plotStack(std::map<std::string, TH1F*> histsin, std::vector<float> xrange, std::string plotdir, std::string variable, int rebin=1)
+void plotStack(std::map<std::string, TH1F*> histsin, std::vector<float> xrange, std::string plotdir, std::string variable, int rebin=1, std::vector<double> binEdges={})
 {
     /*
     plot a stack of filled histograms
@@ -56,6 +57,7 @@ void plotStack(std::map<std::string, TH1F*> histsin, std::vector<float> xrange,
         plotdir (std::string): directory to save plot to.
         variable (std::string): name of variable to plot.
         rebin (int): to rebin newbinwidth = rebin * oldbinwidth
+        binEdges (std::vector<double>): if given, rebin to these variable-width bins instead (each edge must be an edge of the input bins).
 
     */
     if (xrange.size() < 2) throw std::out_of_range("need 2 values for x axis range");
@@ -98,7 +100,8 @@ void plotStack(std::map<std::string, TH1F*> histsin, std::vector<float> xrange,
         TH1F* histin = it->second;
         hist.insert(std::pair<std::string, TH1F*>(label, (TH1F*)histin->Clone(label.c_str())));
         hist[label]->Sumw2();
-        if (rebin!=1) hist[label]->Rebin(rebin);
+        if (!binEdges.empty()) hist[label] = (TH1F*)hist[label]->Rebin(binEdges.size()-1, (label+"_rebinned").c_str(), binEdges.data());
+        else if (rebin!=1) hist[label]->Rebin(rebin);
         hist[label]->GetXaxis()->SetRangeUser(xrange[0], xrange[1]);
         hist[label]->SetFillColor(colourdict[label]);
         stack->Add(hist[label]);
@@ -388,6 +391,14 @@ int main(int argc, char* argv[])
     gStyle->SetPalette(112);
     gStyle->SetTitleYOffset(1.1);
 
+    // With "--server [socket path]" we ask the local histogram server (hist_server_root) for the histograms instead of
+    // reading the histogram files, which is much quicker when replotting over and over.
+    HistServerClient* server = nullptr;
+    if (argc > 1 && std::string(argv[1]) == "--server")
+    {
+        server = (argc > 2) ? new HistServerClient(argv[2]) : new HistServerClient();
+    }
+
     // Define out input and output paths, make sure the output path exists.
     std::string histPath = "histograms/GamGam_root/";
     std::string plotPath = "plots/GamGam_root/";
@@ -400,19 +411,22 @@ int main(int argc, char* argv[])
     // First do the Stack plot example.
     // config our samples and variables
     std::vector<std::string> samplesToStack = {"VBFHiggs", "ggfHiggs"};
-    std::vector<std::string> varsToPlot = {"diphoton_mass"};
+    std::vector<std::string> varsToPlot = {"diphoton_mass", "photon_pT_1"};
     
     // Note we already nicely defined our x-axis label and binning in the previous script, but you could override/refine that here.
-    std::map<std::string, std::vector<float>> xrangeDict = {{"diphoton_mass", {0., 500}}};
-    std::map<std::string, int> rebinDict = {{"diphoton_mass", 5}};
+    std::map<std::string, std::vector<float>> xrangeDict = {{"diphoton_mass", {0., 500}}, {"photon_pT_1", {0., 500}}};
+    std::map<std::string, int> rebinDict = {{"diphoton_mass", 5}, {"photon_pT_1", 1}};
 
-    // TODO can you alter the function to allow us to use variable size bins?
+    // The photon pT histograms are already made with variable-size bins (see HistMaker::photonPtEdges), we can merge them
+    // further into wider variable bins here, as long as the new edges are a subset of the old ones.
     // rebin docs here: https://root.cern.ch/doc/master/classTH1.html#a9eef6f499230b88582648892e5e4e2ce
+    std::map<std::string, std::vector<double>> binEdgesDict = {{"photon_pT_1", {0., 25., 35., 45., 55., 70., 90., 120., 170., 250., 500.}}};
     
     // retrieve the histogram files
     std::map<std::string, TFile*> files;
     for (auto sample : samplesToStack)
     {
+        if (server) break;
         std::string filename = histPath + sample + ".root";
         files[sample] = new TFile(filename.c_str(), "READ");
         std::cout << files[sample] << std::endl;
@@ -423,11 +437,11 @@ int main(int argc, char* argv[])
         std::map<std::string, TH1F*> histsin;
         for (auto sample : samplesToStack)
         {
-            histsin[sample] = (TH1F*)files[sample]->Get(var.c_str());
+            histsin[sample] = server ? server->GetHist(sample, var) : (TH1F*)files[sample]->Get(var.c_str());
             std::cout << histsin[sample] << std::endl;
         }
         // produce the stack plots
-        plotStack(histsin, xrangeDict[var], plotPath, var, rebinDict[var]);
+        plotStack(histsin, xrangeDict[var], plotPath, var, rebinDict[var], binEdgesDict[var]);
     }
 
     //===============================================================================================================
@@ -443,16 +457,31 @@ int main(int argc, char* argv[])
     // TODO can you alter the function to allow us to rebin the histograms?
     
     // read in the signal and data histograms
-    std::string sigHistPath = histPath + "allHiggs.root";
-    TFile* sigFile = new TFile(sigHistPath.c_str(), "READ");
-    std::string dataHistPath = histPath + "data.root";
-    TFile* dataFile = new TFile(dataHistPath.c_str(), "READ");
-    TH1F* sigHist = (TH1F*)sigFile->Get(variable.c_str());
-    TH1F* dataHist = (TH1F*)dataFile->Get(variable.c_str());
+    TFile* sigFile = nullptr;
+    TFile* dataFile = nullptr;
+    TH1F* sigHist;
+    TH1F* dataHist;
+    if (server)
+    {
+        // the server has the signal samples separately, rather than the hadd-ed allHiggs
+        sigHist = server->GetHist("ggfHiggs", variable);
+        sigHist->Add(server->GetHist("VBFHiggs", variable));
+        dataHist = server->GetHist("data", variable);
+    }
+    else
+    {
+        std::string sigHistPath = histPath + "allHiggs.root";
+        sigFile = new TFile(sigHistPath.c_str(), "READ");
+        std::string dataHistPath = histPath + "data.root";
+        dataFile = new TFile(dataHistPath.c_str(), "READ");
+        sigHist = (TH1F*)sigFile->Get(variable.c_str());
+        dataHist = (TH1F*)dataFile->Get(variable.c_str());
+    }
     
     plotSigBgData(sigHist, dataHist, fitRange, plotPath, variable, blind, rangeToBlind);
 
     delete sigFile;
     delete dataFile;
+    delete server;
 
 }
\ No newline at end of file
@@ -33,13 +33,60 @@ int main(int argc, char* argv[])
 {
     // Want command line arguments to be:
     //  (1) sample (data, ggfHiggs, VBFHiggs)
+    // followed by any of the options:
+    //  --threads N      process the events on N threads (implies --reproducible)
+    //  --reproducible   sum in fixed chunks so the output doesn't depend on the number of threads
+    //  --chunk-size N   number of events per chunk in reproducible mode
+    //  --cut NAME=VALUE change a selection setting, e.g. --cut photon_2_pt=30 (see HistMaker::CutSettings for the names)
+    //  --cut-cache FILE save the per-event cut results to FILE while running
+    //  --from-cache FILE don't read the ntuples, redo the selection from a cut cache made earlier.
+    //                   Not with --threads, --reproducible, --bootstrap, --cut-cache, --checkpoint or --resume.
+    //  --bootstrap N    also fill N Poisson bootstrap replicas of each histogram
+    //  --checkpoint FILE save the progress to FILE every so often (every 10 minutes unless set below)
+    //  --checkpoint-events N / --checkpoint-seconds T  how often to save the checkpoint
+    //  --resume         carry on from the checkpoint FILE of an earlier run that didn't finish
     // argc is our args + 1
-    if (argc==2){
+    if (argc>=2){
         const char* sample = argv[1];
         std::stringstream ssSample;
         ssSample << sample;
         std::string strSample = ssSample.str();
 
+        // Initalise out HistMaker class
+        HistMaker myHistMaker;
+        std::string fromCache = "";
+        for (int iarg=2; iarg<argc; iarg++)
+        {
+            std::string arg = argv[iarg];
+            if (arg == "--reproducible") myHistMaker.reproducible = true;
+            else if (arg == "--threads" && iarg+1 < argc) myHistMaker.nThreads = std::stoi(argv[++iarg]);
+            else if (arg == "--chunk-size" && iarg+1 < argc) myHistMaker.chunkSize = std::stoll(argv[++iarg]);
+            else if (arg == "--cut-cache" && iarg+1 < argc) myHistMaker.cutCachePath = argv[++iarg];
+            else if (arg == "--from-cache" && iarg+1 < argc) fromCache = argv[++iarg];
+            else if (arg == "--bootstrap" && iarg+1 < argc) myHistMaker.nBootstrap = std::stoi(argv[++iarg]);
+            else if (arg == "--checkpoint" && iarg+1 < argc) myHistMaker.checkpointPath = argv[++iarg];
+            else if (arg == "--checkpoint-events" && iarg+1 < argc) myHistMaker.checkpointEvents = std::stoll(argv[++iarg]);
+            else if (arg == "--checkpoint-seconds" && iarg+1 < argc) myHistMaker.checkpointSeconds = std::stod(argv[++iarg]);
+            else if (arg == "--resume") myHistMaker.resume = true;
+            else if (arg == "--cut" && iarg+1 < argc)
+            {
+                std::string setting = argv[++iarg];
+                size_t split = setting.find('=');
+                if (split == std::string::npos || !myHistMaker.SetCut(setting.substr(0, split), std::stof(setting.substr(split+1))))
+                {
+                    throw std::runtime_error("can't set the cut "+setting);
+                }
+            }
+            else throw std::runtime_error("unknown option "+arg);
+        }
+        if (myHistMaker.nThreads < 1) throw std::runtime_error("--threads needs at least 1 thread");
+        if (myHistMaker.chunkSize < 1) throw std::runtime_error("--chunk-size needs at least 1 event");
+        if (myHistMaker.resume && myHistMaker.checkpointPath.empty()) throw std::runtime_error("--resume needs the --checkpoint file to resume from");
+        if (!myHistMaker.checkpointPath.empty() && myHistMaker.checkpointEvents <= 0 && myHistMaker.checkpointSeconds <= 0.)
+        {
+            myHistMaker.checkpointSeconds = 600.;
+        }
+
         // TODO not ideal to have these hard-coded paths... how could you make this more flexible? 
         std::string ntuplePath = "data/GamGam";
         std::string outputPath = "histograms/GamGam_rootCpp/";
@@ -80,10 +127,9 @@ int main(int argc, char* argv[])
                 }
         }
 
-        // Initalise out HistMaker class
-        HistMaker myHistMaker;
-        // Run the event looper on our sample.
-        myHistMaker.EventLooper(chain, outHists, isData);
+        // Run the event looper on our sample, or just redo the selection if we have the cut results already.
+        if (!fromCache.empty()) myHistMaker.RefillFromCache(fromCache, outHists);
+        else myHistMaker.EventLooper(chain, outHists, isData);
 
     }
     else
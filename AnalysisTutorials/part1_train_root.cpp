@@ -0,0 +1,115 @@
+#include "AnalysisTrain.h"
+#include "AnalysisModules.h"
+
+// Root headers
+#include "TROOT.h"
+#include "TFile.h"
+#include "TChain.h"
+
+// c++ headers
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <sys/stat.h>
+#include <stdexcept>
+
+/*
+Runs several analyses over the GamGam ntuples in one go, with the AnalysisTrain: the branches they need are read once
+and every module gets each batch of events. Each module writes its own output file, <sample>_<module>.root.
+
+The diphoton module is the same selection as part1_process_TTree_root, so
+  ./compare_hists_root histograms/GamGam_rootCpp/data.root histograms/GamGam_rootCpp/data_diphoton.root
+should report no differences.
+
+Things to try:
+- write your own module (e.g. a diphoton mass sideband control region) and add it to the train below.
+- compare the time and the MB read for one module and for all of them.
+*/
+
+// Main function to run in executable
+int main(int argc, char* argv[])
+{
+    // Want command line arguments to be:
+    //  (1) sample (data, ggfHiggs, VBFHiggs)
+    // followed by any of the options:
+    //  --modules A,B    only run these modules (default all: diphoton,photonjet)
+    //  --batch-size N   number of events read per batch
+    //  --serial         run the modules one after another instead of in parallel
+    //  --cut NAME=VALUE change a selection setting of the diphoton module, as for part1_process_TTree_root.
+    //                   luminosity_ifb is for the whole train, it sets the MC weights of all the modules.
+    if (argc>=2){
+        std::string strSample = argv[1];
+
+        AnalysisTrain train;
+        DiphotonModule diphoton;
+        PhotonJetModule photonjet;
+        std::string moduleNames = "diphoton,photonjet";
+        for (int iarg=2; iarg<argc; iarg++)
+        {
+            std::string arg = argv[iarg];
+            if (arg == "--modules" && iarg+1 < argc) moduleNames = argv[++iarg];
+            else if (arg == "--batch-size" && iarg+1 < argc) train.batchSize = std::stoll(argv[++iarg]);
+            else if (arg == "--serial") train.parallel = false;
+            else if (arg == "--cut" && iarg+1 < argc)
+            {
+                std::string setting = argv[++iarg];
+                size_t split = setting.find('=');
+                if (split == std::string::npos) throw std::runtime_error("can't set the cut "+setting);
+                std::string name = setting.substr(0, split);
+                float value = std::stof(setting.substr(split+1));
+                if (name == "luminosity_ifb") train.luminosity_ifb = value;
+                else if (!diphoton.histMaker.SetCut(name, value)) throw std::runtime_error("can't set the cut "+setting);
+            }
+            else throw std::runtime_error("unknown option "+arg);
+        }
+        if (train.batchSize < 1) throw std::runtime_error("--batch-size needs at least 1 event");
+
+        std::map<std::string, AnalysisModule*> available = {{diphoton.name, &diphoton}, {photonjet.name, &photonjet}};
+        std::stringstream ssModules(moduleNames);
+        std::string moduleName;
+        while (std::getline(ssModules, moduleName, ','))
+        {
+            if (available.find(moduleName) == available.end()) throw std::runtime_error("no module called "+moduleName);
+            train.AddModule(available[moduleName]);
+        }
+
+        // TODO not ideal to have these hard-coded paths... how could you make this more flexible?
+        std::string ntuplePath = "data/GamGam";
+        std::string outputPath = "histograms/GamGam_rootCpp/";
+        struct stat check;
+        if (stat(outputPath.c_str(), &check) != 0){
+            throw std::runtime_error(outputPath+" doesn't exist, please create it.");
+        }
+
+        bool isData = (strSample.find("data") != std::string::npos) || (strSample.find("Data") != std::string::npos);
+
+        std::string treename = "mini";
+        TChain* chain = new TChain(treename.c_str(), "");
+        if (isData){
+            std::vector dataindices = {"A", "B", "C", "D"};
+            for (auto i : dataindices)
+            {
+                std::string filename = ntuplePath + "/Data/data_" + i + ".GamGam.root";
+                chain->Add(filename.c_str());
+            }
+        }
+        else
+        {
+            std::map<std::string, std::string> MCnames = {
+                {"ggfHiggs", "/MC/mc_343981.ggH125_gamgam.GamGam.root"},
+                {"VBFHiggs", "/MC/mc_345041.VBFH125_gamgam.GamGam.root"}
+            };
+            if (MCnames.find(strSample) == MCnames.end()) throw std::runtime_error("not a valid input choice: select data, ggfHiggs or VBFHiggs");
+            std::string filename = ntuplePath + MCnames[strSample];
+            chain->Add(filename.c_str());
+        }
+
+        train.Run(chain, outputPath + strSample + "_", isData);
+        delete chain;
+    }
+    else
+    {
+        throw std::runtime_error("need 1 argument for what sample to run over");
+    }
+
+}
@@ -0,0 +1,28 @@
+#!/bin/bash
+# Two stage profile guided optimisation build of the analysis executables with CMake.
+# Run from the top of the repo with bash setup/build_pgo.sh, with the ROOT environment set up and the GamGam data in data/GamGam.
+# Any extra arguments are passed on to cmake, e.g. -DCMPP_ISA_VARIANTS="avx2;avx512"
+# Stops at the first step that fails, so a broken stage 1 or training run doesn't leave a build without profiles.
+set -e
+
+PGO_DIR="$PWD/pgo-profiles"
+rm -rf "$PGO_DIR"
+
+# stage 1: instrumented build
+cmake -S . -B build-pgo-generate -DCMAKE_BUILD_TYPE=Release -DCMPP_PGO=GENERATE -DCMPP_PGO_DIR="$PGO_DIR" "$@"
+cmake --build build-pgo-generate -j
+
+# training run: the event loop over a signal MC sample and the data, both the plain and the threaded reproducible mode.
+mkdir -p histograms/GamGam_rootCpp
+./build-pgo-generate/part1_process_TTree_root ggfHiggs
+./build-pgo-generate/part1_process_TTree_root data
+./build-pgo-generate/part1_process_TTree_root data --threads 4
+
+# stage 2: optimised build using the profiles, this is the one to use.
+cmake -S . -B build -DCMAKE_BUILD_TYPE=Release -DCMPP_PGO=USE -DCMPP_PGO_DIR="$PGO_DIR" "$@"
+cmake --build build -j
+
+# the training run overwrote the histograms, so make them again with the optimised build.
+./build/part1_process_TTree_root ggfHiggs
+./build/part1_process_TTree_root VBFHiggs
+./build/part1_process_TTree_root data
@@ -0,0 +1 @@
+ g++ AnalysisTutorials/compare_hists_root.cpp -Wall -o compare_hists_root `root-config --cflags` `root-config --libs`
@@ -0,0 +1 @@
+ g++ AnalysisTutorials/hist_server_root.cpp AnalysisTutorials/HistMaker.cpp AnalysisTutorials/ReproducibleHist.cpp AnalysisTutorials/Bootstrap.cpp AnalysisTutorials/BinLookup.cpp -Wall -o hist_server_root `root-config --cflags` `root-config --libs` -lrt
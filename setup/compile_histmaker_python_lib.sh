@@ -0,0 +1,3 @@
+ g++ -shared -fPIC -O2 AnalysisTutorials/HistMaker.cpp AnalysisTutorials/ReproducibleHist.cpp AnalysisTutorials/Bootstrap.cpp AnalysisTutorials/BinLookup.cpp AnalysisTutorials/HistMakerCAPI.cpp -Wall -o libHistMakerPy.so `root-config --cflags` `root-config --libs`
+
+# the library is picked up by utils/histmaker.py from the top of the repo, or from the HISTMAKER_LIB path if set.
@@ -1,3 +1,3 @@
- g++ AnalysisTutorials/part1_plotter_root.cpp  -Wall -o part1_plotter_root `root-config --cflags` `root-config --libs`
+ g++ AnalysisTutorials/part1_plotter_root.cpp AnalysisTutorials/HistServerClient.cpp -Wall -o part1_plotter_root `root-config --cflags` `root-config --libs` -lrt
 
 # you could try writing a makefile to compile this?
@@ -1,3 +1,3 @@
- g++ AnalysisTutorials/part1_process_TTree_root.cpp AnalysisTutorials/HistMaker.cpp -Wall -o part1_process_TTree_root `root-config --cflags` `root-config --libs`
+ g++ AnalysisTutorials/part1_process_TTree_root.cpp AnalysisTutorials/HistMaker.cpp AnalysisTutorials/ReproducibleHist.cpp AnalysisTutorials/Bootstrap.cpp AnalysisTutorials/BinLookup.cpp -Wall -o part1_process_TTree_root `root-config --cflags` `root-config --libs`
 
 # you could try writing a makefile to compile this?
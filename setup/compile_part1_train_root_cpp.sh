@@ -0,0 +1 @@
+ g++ AnalysisTutorials/part1_train_root.cpp AnalysisTutorials/AnalysisTrain.cpp AnalysisTutorials/AnalysisModules.cpp AnalysisTutorials/HistMaker.cpp AnalysisTutorials/ReproducibleHist.cpp AnalysisTutorials/Bootstrap.cpp AnalysisTutorials/BinLookup.cpp -Wall -o part1_train_root `root-config --cflags` `root-config --libs`
@@ -0,0 +1,7 @@
+# make the cut caches the server loads (only needed once, or when the ntuples change)
+./part1_process_TTree_root ggfHiggs --cut-cache histograms/GamGam_rootCpp/ggfHiggs_cuts.root
+./part1_process_TTree_root VBFHiggs --cut-cache histograms/GamGam_rootCpp/VBFHiggs_cuts.root
+./part1_process_TTree_root data --cut-cache histograms/GamGam_rootCpp/data_cuts.root
+
+# start the server in the background, then e.g. ./part1_plotter_root --server
+./hist_server_root ggfHiggs=histograms/GamGam_rootCpp/ggfHiggs_cuts.root VBFHiggs=histograms/GamGam_rootCpp/VBFHiggs_cuts.root data=histograms/GamGam_rootCpp/data_cuts.root &
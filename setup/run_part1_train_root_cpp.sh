@@ -0,0 +1,4 @@
+# all the analysis modules in one read of each sample, one output file per sample and module
+./part1_train_root ggfHiggs
+./part1_train_root VBFHiggs
+./part1_train_root data
@@ -0,0 +1,132 @@
+"""
+Python client for the local histogram server (AnalysisTutorials/hist_server_root.cpp).
+
+Start the server once with the cut caches of the samples, then in any notebook:
+    client = HistServerClient()
+    h = client.hist("ggfHiggs", "diphoton_mass", cuts={"photon_2_pt": 30.})
+Requests go over a Unix socket, the histogram values and event columns come back through shared memory.
+See AnalysisTutorials/HistServerClient.h for the protocol.
+"""
+
+import mmap
+import os
+import socket
+
+import numpy as np
+
+DEFAULT_SOCKET = "/tmp/cmpp_hist_server.sock"
+
+
+def _map_shm(name, nbytes):
+    """
+    Map a POSIX shared memory segment read-only.
+
+    Args:
+        name (str): segment name as given by the server, e.g. /cmpp_cols_data
+        nbytes (int): number of bytes to map
+
+    Returns:
+        mmap.mmap: the mapped memory
+    """
+    fd = os.open("/dev/shm/" + name.lstrip("/"), os.O_RDONLY)
+    try:
+        return mmap.mmap(fd, nbytes, mmap.MAP_SHARED, mmap.PROT_READ)
+    finally:
+        os.close(fd)
+
+
+class HistServerClient:
+    """
+    A connection to the histogram server.
+
+    Args:
+        socket_path (str): path of the server's Unix socket.
+    """
+
+    def __init__(self, socket_path=DEFAULT_SOCKET):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(socket_path)
+        self.buffer = b""
+
+    def close(self):
+        """
+        Close the connection (the server then frees this connection's shared memory).
+        """
+        self.sock.close()
+
+    def request(self, line):
+        """
+        Send one request line and wait for the reply.
+
+        Args:
+            line (str): the request, e.g. "SAMPLES"
+
+        Returns:
+            list of str: the words of the reply after "OK"
+        """
+        self.sock.sendall((line + "\n").encode())
+        while b"\n" not in self.buffer:
+            chunk = self.sock.recv(4096)
+            if not chunk:
+                raise ConnectionError("lost the connection to the histogram server")
+            self.buffer += chunk
+        reply, self.buffer = self.buffer.split(b"\n", 1)
+        words = reply.decode().split()
+        if not words or words[0] != "OK":
+            raise RuntimeError("histogram server: " + reply.decode())
+        return words[1:]
+
+    def samples(self):
+        """
+        Returns:
+            list of str: the samples the server has loaded
+        """
+        return self.request("SAMPLES")[1:]
+
+    def hist(self, sample, name, cuts=None):
+        """
+        Get one of the HistMaker histograms (or the cutflow) for a sample, optionally with changed cuts.
+
+        Args:
+            sample (str): sample name, as given to the server.
+            name (str): histogram name, e.g. "diphoton_mass" or "cutflow".
+            cuts (dict of str:float): selection settings to change, by HistMaker::SetCut name.
+
+        Returns:
+            dict: "edges", "contents" and "sumw2", where contents and sumw2 include the underflow and overflow bins
+        """
+        line = "HIST {} {}".format(sample, name)
+        for cut, value in (cuts or {}).items():
+            line += " {}={}".format(cut, value)
+        shm_name, nvalues, nbins = self.request(line)[:3]
+        nvalues, nbins = int(nvalues), int(nbins)
+        mem = _map_shm(shm_name, nvalues * 8)
+        # the segment is reused for this connection's next request, so take a copy.
+        values = np.frombuffer(mem, dtype=np.float64, count=nvalues).copy()
+        mem.close()
+        return {
+            "edges": values[2 * (nbins + 2):],
+            "contents": values[:nbins + 2],
+            "sumw2": values[nbins + 2:2 * (nbins + 2)],
+        }
+
+    def columns(self, sample):
+        """
+        Map the resident event columns of a sample (every event with 2 photons) without copying them.
+
+        Args:
+            sample (str): sample name, as given to the server.
+
+        Returns:
+            dict: column name to read-only numpy array, "mask" holds the cut mask of each event (see HistMaker.h)
+        """
+        words = self.request("COLUMNS " + sample)
+        shm_name, nevents, names = words[0], int(words[1]), words[2:]
+        if nevents == 0:
+            return {name: np.zeros(0) for name in names}
+        mem = _map_shm(shm_name, len(names) * nevents * 4)
+        columns = {}
+        for i, name in enumerate(names):
+            dtype = np.uint32 if name == "mask" else np.float32
+            columns[name] = np.frombuffer(mem, dtype=dtype, count=nevents, offset=i * nevents * 4)
+        return columns
@@ -0,0 +1,142 @@
+"""
+Python access to the C++ HistMaker event loop, so the notebooks can run the selection at native speed.
+
+Needs the shared library built by setup/compile_histmaker_python_lib.sh (and ROOT's libraries to be findable).
+The histograms and skim columns are returned as numpy arrays that look directly at the memory owned by the
+C++ HistMaker, nothing is copied. They keep the HistMaker alive for as long as you hold on to them.
+"""
+
+import ctypes
+import os
+
+import numpy as np
+
+_lib = None
+
+
+def _load_lib():
+    """
+    Load the HistMaker shared library once and declare the argument/return types of the C functions.
+
+    Returns:
+        ctypes.CDLL: the loaded library
+    """
+    global _lib
+    if _lib is not None:
+        return _lib
+    default_path = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "libHistMakerPy.so")
+    lib = ctypes.CDLL(os.environ.get("HISTMAKER_LIB", default_path))
+
+    handle = ctypes.c_void_p
+    lib.hm_create.restype = handle
+    lib.hm_destroy.argtypes = [handle]
+    lib.hm_last_error.argtypes = [handle]
+    lib.hm_last_error.restype = ctypes.c_char_p
+    lib.hm_set_cut.argtypes = [handle, ctypes.c_char_p, ctypes.c_float]
+    lib.hm_set_threads.argtypes = [handle, ctypes.c_int, ctypes.c_int]
+    lib.hm_run.argtypes = [handle, ctypes.c_char_p, ctypes.POINTER(ctypes.c_char_p), ctypes.c_int, ctypes.c_int, ctypes.c_int]
+    lib.hm_n_hists.argtypes = [handle]
+    lib.hm_hist_name.argtypes = [handle, ctypes.c_int]
+    lib.hm_hist_name.restype = ctypes.c_char_p
+    lib.hm_hist_nbins.argtypes = [handle, ctypes.c_int]
+    lib.hm_hist_edges.argtypes = [handle, ctypes.c_int, ctypes.POINTER(ctypes.c_double)]
+    lib.hm_hist_contents.argtypes = [handle, ctypes.c_int]
+    lib.hm_hist_contents.restype = ctypes.POINTER(ctypes.c_double)
+    lib.hm_hist_sumw2.argtypes = [handle, ctypes.c_int]
+    lib.hm_hist_sumw2.restype = ctypes.POINTER(ctypes.c_double)
+    lib.hm_skim_size.argtypes = [handle]
+    lib.hm_skim_size.restype = ctypes.c_long
+    lib.hm_n_skim_columns.argtypes = [handle]
+    lib.hm_skim_name.argtypes = [handle, ctypes.c_int]
+    lib.hm_skim_name.restype = ctypes.c_char_p
+    lib.hm_skim_column.argtypes = [handle, ctypes.c_int]
+    lib.hm_skim_column.restype = ctypes.POINTER(ctypes.c_float)
+    _lib = lib
+    return lib
+
+
+class _HistMakerHandle:
+    """
+    Owns the C++ HistMaker, deleting it once nothing (including the numpy views) refers to it any more.
+    """
+
+    def __init__(self):
+        self.lib = _load_lib()
+        self.ptr = self.lib.hm_create()
+
+    def __del__(self):
+        if self.ptr:
+            self.lib.hm_destroy(self.ptr)
+            self.ptr = None
+
+
+def _view(owner, pointer, ctype, size):
+    """
+    Wrap a C++ buffer in a numpy array without copying it.
+
+    Args:
+        owner (_HistMakerHandle): object owning the memory, kept alive by the returned array.
+        pointer (ctypes pointer): start of the buffer.
+        ctype (ctypes type): element type of the buffer.
+        size (int): number of elements.
+
+    Returns:
+        np.ndarray: read-only view of the buffer
+    """
+    if size == 0:
+        return np.zeros(0, dtype=ctype)
+    buffer = (ctype * size).from_address(ctypes.addressof(pointer.contents))
+    # the ctypes array is the base of the numpy array, so hanging the owner on it ties their lifetimes together.
+    buffer._owner = owner
+    array = np.frombuffer(buffer, dtype=ctype)
+    array.flags.writeable = False
+    return array
+
+
+def run_histmaker(files, is_data, cuts=None, store_skim=True, treename="mini", threads=1, reproducible=False):
+    """
+    Run the C++ HistMaker event loop over a list of input files.
+
+    Args:
+        files (list of str): input ROOT files (e.g. the data_A-D.GamGam.root files for data).
+        is_data (bool): True for data, False for MC (which gets the MC event weights applied).
+        cuts (dict of str:float): selection settings to change, by HistMaker::SetCut name, e.g. {"photon_2_pt": 30.}
+        store_skim (bool): also return the per-event columns of the selected events.
+        treename (str): name of the TTree in the files.
+        threads (int): number of threads for the event loop (skim columns are only kept with 1 thread).
+        reproducible (bool): sum in fixed chunks, so the histograms are identical for any number of threads.
+
+    Returns:
+        dict: "hists" maps histogram name to a dict of "edges", "contents" and "sumw2" (contents and sumw2
+              include the underflow and overflow bins at either end), "skim" maps column name to the values.
+    """
+    owner = _HistMakerHandle()
+    lib = owner.lib
+
+    for name, value in (cuts or {}).items():
+        if lib.hm_set_cut(owner.ptr, name.encode(), value) != 0:
+            raise KeyError(lib.hm_last_error(owner.ptr).decode())
+
+    lib.hm_set_threads(owner.ptr, threads, int(reproducible))
+
+    file_array = (ctypes.c_char_p * len(files))(*[f.encode() for f in files])
+    if lib.hm_run(owner.ptr, treename.encode(), file_array, len(files), int(is_data), int(store_skim)) != 0:
+        raise RuntimeError(lib.hm_last_error(owner.ptr).decode())
+
+    hists = {}
+    for i in range(lib.hm_n_hists(owner.ptr)):
+        nbins = lib.hm_hist_nbins(owner.ptr, i)
+        edges = np.zeros(nbins + 1)
+        lib.hm_hist_edges(owner.ptr, i, edges.ctypes.data_as(ctypes.POINTER(ctypes.c_double)))
+        hists[lib.hm_hist_name(owner.ptr, i).decode()] = {
+            "edges": edges,
+            "contents": _view(owner, lib.hm_hist_contents(owner.ptr, i), ctypes.c_double, nbins + 2),
+            "sumw2": _view(owner, lib.hm_hist_sumw2(owner.ptr, i), ctypes.c_double, nbins + 2),
+        }
+
+    skim = {}
+    nevents = lib.hm_skim_size(owner.ptr)
+    for i in range(lib.hm_n_skim_columns(owner.ptr)):
+        skim[lib.hm_skim_name(owner.ptr, i).decode()] = _view(owner, lib.hm_skim_column(owner.ptr, i), ctypes.c_float, nevents)
+
+    return {"hists": hists, "skim": skim}